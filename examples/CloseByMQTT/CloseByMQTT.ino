@@ -28,6 +28,8 @@ void setup() {
   Serial.begin(9600);
   pinMode(LED_PIN, OUTPUT);
 
+  approx.setFastReconnect(true);
+  approx.setDutyCycle(30000);   //batch MQTT reports into one connection at most every 30 seconds
   if (approx.init("MyHomeWiFi", "password")) {
     approx.setProximateDeviceHandler(onProximateDevice);
     approx.begin([]() {
@@ -51,11 +53,6 @@ void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
     approx.onceWifiStatus(WL_CONNECTED, [](String payload) {
       mqttClient.connect(WiFi.macAddress().c_str());
       mqttClient.publish("closeby", payload.c_str(), false); //false = don't retain message
-      
-      #if defined(ESP8266)
-        delay(20);
-        approx.disconnectWiFi();
-      #endif
     }, json);
     approx.connectWiFi();
   }
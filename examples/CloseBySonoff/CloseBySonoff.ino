@@ -83,7 +83,26 @@ void onCloseBySonoff(Device *device, Approximate::DeviceEvent event) {
   }
 }
 
+Device *getNearestSonoff() {
+  Device *nearestSonoff = NULL;
+
+  //nearest first - so the first Sonoff found is the nearest:
+  Device *nearestDevices[APPROXIMATE_MAX_DEVICES];
+  int count = approx.getNearestDevices(nearestDevices, APPROXIMATE_MAX_DEVICES);
+  for(int n = 0; n < count && !nearestSonoff; ++n) {
+    if(nearestDevices[n] -> getOUI() == 0xD8F15B) nearestSonoff = nearestDevices[n];
+  }
+
+  return(nearestSonoff);
+}
+
 void onButtonEvent(AceButton* button, uint8_t eventType, uint8_t buttonState) {
+  //with more than one close by, switch the nearest:
+  if(eventType == AceButton::kEventPressed) {
+    Device *nearestSonoff = getNearestSonoff();
+    if(nearestSonoff) closeBySonoff = nearestSonoff;
+  }
+
   if(closeBySonoff) {  
     switch (eventType) {
       case AceButton::kEventPressed:
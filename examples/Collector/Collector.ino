@@ -0,0 +1,108 @@
+/*
+    Collector example for the Approximate Library
+    -
+    Gather the observations sent by many Reporter nodes, processing each shard of devices in its own task - ESP32 only
+    -
+    With LOOPBACK_TEST set the collector also runs simulated nodes of its own, which send to it over the loopback interface
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#if !defined(ESP32)
+  #error "The Collector example needs the FreeRTOS tasks of an ESP32"
+#endif
+
+#include <Approximate.h>
+#include <WiFiUdp.h>
+
+const uint16_t COLLECTOR_PORT = 5005;
+const int SHARD_COUNT = 2;                          //one task on each core
+const bool LOOPBACK_TEST = true;
+
+Collector collector(SHARD_COUNT);
+WiFiUDP udp;
+uint8_t batch[ObservationBatch::headerLengthBytes + (ObservationBatch::maxObservations * ObservationBatch::observationLengthBytes)];
+
+//simulated nodes:
+const int NODE_COUNT = 3;
+Approximate nodes[NODE_COUNT];
+Reporter reporters[NODE_COUNT];
+TrafficGenerator generator;
+
+unsigned long reportedAtMs = 0;
+
+void setup() {
+    Serial.begin(9600);
+
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("MyHomeWiFi", "password");
+    while (WiFi.status() != WL_CONNECTED) delay(500);
+    Serial.printf("Collecting on %s:%i\n", WiFi.localIP().toString().c_str(), COLLECTOR_PORT);
+
+    udp.begin(COLLECTOR_PORT);
+
+    //where each node is, in metres - so that devices can be placed between them:
+    collector.setNodePosition(1, 0.0, 0.0);
+    collector.setNodePosition(2, 10.0, 0.0);
+    collector.setNodePosition(3, 0.0, 10.0);
+    collector.setPositionMethod(Collector::TRILATERATION);
+    collector.setNearestNodeHandler(onNearestNode);
+
+    for(int n = 0; n < SHARD_COUNT; ++n) {
+        xTaskCreatePinnedToCore(processShard, "shard", 4096, (void *) n, 1, NULL, n % 2);
+    }
+
+    if(LOOPBACK_TEST) {
+        generator.init(200);
+
+        eth_addr bssid;
+        generator.getBssid(0, bssid);
+        for(int n = 0; n < NODE_COUNT; ++n) {
+            nodes[n].setLocalBSSID(bssid);
+            reporters[n].begin(IPAddress(127, 0, 0, 1), COLLECTOR_PORT, n + 1);
+            nodes[n].setReporter(&reporters[n]);
+        }
+    }
+}
+
+void loop() {
+    if(LOOPBACK_TEST) {
+        //each frame is heard by one of the simulated nodes:
+        for(int n = 0; n < 100; ++n) {
+            uint16_t len;
+            int type;
+            wifi_promiscuous_pkt_t *pkt = generator.next(millis(), len, type);
+            nodes[n % NODE_COUNT].parsePacket(pkt, len, type);
+        }
+        for(int n = 0; n < NODE_COUNT; ++n) nodes[n].loop();
+    }
+
+    int lengthBytes;
+    while((lengthBytes = udp.parsePacket()) > 0) {
+        lengthBytes = udp.read(batch, sizeof(batch));
+        collector.ingest(batch, lengthBytes);
+    }
+
+    if(millis() - reportedAtMs > 5000) {
+        reportedAtMs = millis();
+        Serial.printf("%i devices\t%u observations\t%u dropped\t%u batches lost\n", collector.getDeviceCount(), collector.getIngestedObservationCount(), collector.getDroppedObservationCount(), collector.getLostBatchCount());
+    }
+}
+
+void onNearestNode(Collector::DeviceState *state, int32_t lastNearestNodeId) {
+    eth_addr macAddress;
+    uint64_to_eth_addr(state -> macAddress, &macAddress);
+    char macAddressAs_c_str[18];
+    Approximate::eth_addr_to_c_str(macAddress, macAddressAs_c_str);
+
+    Serial.printf("NEAREST\t%s\tnode %i\t(%.1f, %.1f)\n", macAddressAs_c_str, state -> nearestNodeId, state -> x, state -> y);
+}
+
+void processShard(void *parameter) {
+    int shardIndex = (intptr_t) parameter;
+
+    while(true) {
+        if(collector.process(shardIndex) == 0) delay(1);
+    }
+}
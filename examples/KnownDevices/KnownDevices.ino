@@ -0,0 +1,49 @@
+/*
+    Known Devices example for the Approximate Library
+    -
+    Tell known household devices from strangers as they arrive and depart - the known MAC addresses are held in flash as a Bloom filter
+    -
+    allowlist.h is built from macs.txt with: python3 extras/allowlist.py macs.txt allowlist.h
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+
+    Example documented here > https://github.com/davidchatting/Approximate/tree/master#known-devices---household-or-stranger
+*/
+
+#include <Approximate.h>
+#include "allowlist.h"
+
+Approximate approx;
+Allowlist allowlist;
+
+void setup() {
+    Serial.begin(9600);
+
+    if (allowlist.begin(ALLOWLIST, sizeof(ALLOWLIST))) {
+        Serial.printf("%u known devices\tfalse positive rate %.4f\n", allowlist.getItemCount(), allowlist.getFalsePositiveRate());
+        approx.setAllowlist(&allowlist);
+    }
+
+    if (approx.init("MyHomeWiFi", "password")) {
+        approx.setProximateDeviceHandler(onProximateDevice, APPROXIMATE_SOCIAL_RSSI);
+        approx.begin();
+    }
+}
+
+void loop() {
+    approx.loop();
+}
+
+void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
+    const char *known = device -> isKnown() ? "KNOWN" : "STRANGER";
+
+    switch(event) {
+        case Approximate::ARRIVE:
+            Serial.printf("ARRIVE\t%s\t%s\n", device -> getMacAddressAsString().c_str(), known);
+            break;
+        case Approximate::DEPART:
+            Serial.printf("DEPART\t%s\t%s\n", device -> getMacAddressAsString().c_str(), known);
+            break;
+    }
+}
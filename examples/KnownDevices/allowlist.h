@@ -0,0 +1,5 @@
+//2 MAC addresses - built by allowlist.py
+const uint8_t ALLOWLIST[] PROGMEM = {
+  0x41, 0x50, 0x42, 0x46, 0x18, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+  0x26, 0x4D, 0x92,
+};
@@ -0,0 +1,109 @@
+/*
+    Load Test example for the Approximate Library
+    -
+    Inject synthetic frames from many stations at increasing rates - report the sustained throughput, drop rate and event latency
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include <Approximate.h>
+Approximate approx;
+TrafficGenerator generator;
+Clock replayClock;
+PacketSniffer *packetSniffer = NULL;
+
+const int STATION_COUNT = 200;
+const int BSSID_COUNT = 3;
+const unsigned long OFFERED_RATES[] = {500, 1000, 2000, 4000, 8000, 16000, 32000, 64000};   //frames per second
+const unsigned long STEP_DURATION_MS = 5000;
+const unsigned long RX_QUEUE_LENGTH = 10;   //frames buffered before the radio drops them
+
+unsigned long injectedAtUs = 0;
+unsigned long eventCount = 0;
+unsigned long eventLatencyTotalUs = 0;
+unsigned long eventLatencyMaxUs = 0;
+
+void setup() {
+  Serial.begin(9600);
+  randomSeed(1);
+
+  generator.init(STATION_COUNT, BSSID_COUNT);
+
+  eth_addr localBSSID;
+  generator.getBssid(0, localBSSID);
+  approx.setLocalBSSID(localBSSID);
+  approx.setClock(&replayClock);
+  approx.setProximateDeviceHandler(onProximateDevice, APPROXIMATE_PUBLIC_RSSI, /*lastSeenTimeoutMs*/ 60000);
+  approx.setActiveDeviceHandler(onActiveDevice);
+
+  packetSniffer = PacketSniffer::getInstance();
+
+  Serial.printf("offered/s\tsustained/s\tdropped\tmean latency\tmax latency\tdropped arrivals\n");
+  for(int n = 0; n < sizeof(OFFERED_RATES) / sizeof(OFFERED_RATES[0]); ++n) {
+    runStep(OFFERED_RATES[n]);
+  }
+}
+
+void loop() {
+}
+
+void runStep(unsigned long offeredRate) {
+  unsigned long sentCount = 0;
+  unsigned long droppedCount = 0;
+  unsigned long droppedArrivalCount = approx.getDroppedArrivalCount();
+  eventCount = eventLatencyTotalUs = eventLatencyMaxUs = 0;
+
+  unsigned long startedAtUs = micros();
+  unsigned long loopedAtMs = millis();
+  unsigned long elapsedUs = 0;
+
+  while((elapsedUs = micros() - startedAtUs) < STEP_DURATION_MS * 1000) {
+    //frames that have arrived by now - those beyond what the queue can hold are lost:
+    unsigned long dueCount = (unsigned long) (((uint64_t) elapsedUs * offeredRate) / 1000000);
+    if(dueCount - (sentCount + droppedCount) > RX_QUEUE_LENGTH) {
+      droppedCount = dueCount - sentCount - RX_QUEUE_LENGTH;
+    }
+
+    if(sentCount + droppedCount < dueCount) {
+      uint16_t len;
+      int type;
+      wifi_promiscuous_pkt_t *pkt = generator.next(replayClock.getTimeMs(), len, type);
+
+      injectedAtUs = micros();
+      packetSniffer -> inject(pkt, len, type);
+      sentCount++;
+    }
+
+    //the replay clock follows real time:
+    if(millis() - loopedAtMs >= 10) {
+      loopedAtMs = millis();
+      replayClock.setTimeMs(loopedAtMs);
+      approx.loop();
+    }
+    yield();
+  }
+
+  unsigned long sustainedRate = (unsigned long) (((uint64_t) sentCount * 1000000) / elapsedUs);
+  float droppedPercent = (sentCount + droppedCount) > 0 ? (100.0 * droppedCount) / (sentCount + droppedCount) : 0.0;
+  unsigned long meanLatencyUs = eventCount > 0 ? eventLatencyTotalUs / eventCount : 0;
+
+  Serial.printf("%lu\t%lu\t%.1f%%\t%luus\t%luus\t%lu\n", offeredRate, sustainedRate, droppedPercent, meanLatencyUs, eventLatencyMaxUs, approx.getDroppedArrivalCount() - droppedArrivalCount);
+}
+
+void onEvent() {
+  unsigned long latencyUs = micros() - injectedAtUs;
+
+  eventCount++;
+  eventLatencyTotalUs += latencyUs;
+  if(latencyUs > eventLatencyMaxUs) eventLatencyMaxUs = latencyUs;
+}
+
+void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
+  //departures come from loop(), not from a frame:
+  if(event == Approximate::ARRIVE) onEvent();
+}
+
+void onActiveDevice(Device *device, Approximate::DeviceEvent event) {
+  onEvent();
+}
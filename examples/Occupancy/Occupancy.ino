@@ -0,0 +1,54 @@
+/*
+    Occupancy example for the Approximate Library
+    -
+    Estimate how many distinct devices have been heard in the last 5, 15 and 60 minutes - in total, and within the personal and social zones
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+
+    Example documented here > https://github.com/davidchatting/Approximate/tree/master#occupancy---how-many-devices-about
+*/
+
+#include <Approximate.h>
+Approximate approx;
+
+OccupancyCounter allCounter;
+OccupancyCounter personalCounter;
+OccupancyCounter socialCounter;
+
+const uint32_t MINUTE_MS = 60000;
+unsigned long printedAtMs = 0;
+
+void setup() {
+    Serial.begin(9600);
+
+    //each within its budget of memory - a 10% error over an hour, in five minute buckets:
+    allCounter.init(0.1, 60 * MINUTE_MS, 5 * MINUTE_MS);
+    personalCounter.init(0.1, 60 * MINUTE_MS, 5 * MINUTE_MS);
+    socialCounter.init(0.1, 60 * MINUTE_MS, 5 * MINUTE_MS);
+
+    personalCounter.setRSSIRange(APPROXIMATE_PERSONAL_RSSI, APPROXIMATE_INTIMATE_RSSI);
+    socialCounter.setRSSIRange(APPROXIMATE_SOCIAL_RSSI, APPROXIMATE_PERSONAL_RSSI);
+
+    if (approx.init("MyHomeWiFi", "password")) {
+        approx.addOccupancyCounter(&allCounter);
+        approx.addOccupancyCounter(&personalCounter);
+        approx.addOccupancyCounter(&socialCounter);
+        approx.begin();
+    }
+
+    Serial.printf("Relative error %.3f\n", allCounter.getRelativeError());
+}
+
+void loop() {
+    approx.loop();
+
+    if(millis() - printedAtMs > MINUTE_MS) {
+        printedAtMs = millis();
+        uint64_t nowMs = approx.getClock() -> getTimeMs();
+
+        Serial.printf("ALL\t%u\t%u\t%u\n", allCounter.getCount(5 * MINUTE_MS, nowMs), allCounter.getCount(15 * MINUTE_MS, nowMs), allCounter.getCount(60 * MINUTE_MS, nowMs));
+        Serial.printf("PERSONAL\t%u\t%u\t%u\n", personalCounter.getCount(5 * MINUTE_MS, nowMs), personalCounter.getCount(15 * MINUTE_MS, nowMs), personalCounter.getCount(60 * MINUTE_MS, nowMs));
+        Serial.printf("SOCIAL\t%u\t%u\t%u\n", socialCounter.getCount(5 * MINUTE_MS, nowMs), socialCounter.getCount(15 * MINUTE_MS, nowMs), socialCounter.getCount(60 * MINUTE_MS, nowMs));
+    }
+}
@@ -0,0 +1,88 @@
+/*
+    Replay example for the Approximate Library
+    -
+    Replay a pcap or pcapng capture, stored in flash, through the pipeline on a virtual clock - frames are read in place, never copied
+    -
+    The capture is written to a data partition labelled "capture", for example with: parttool.py write_partition --partition-name=capture --input=capture.pcap
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include <Approximate.h>
+#if defined(ESP32)
+  #include <esp_partition.h>
+#endif
+
+Approximate approx;
+Clock virtualClock;
+
+const char *LOCAL_BSSID = "00:00:00:00:00:00";    //the access point of interest in the capture
+
+unsigned long arrivals = 0;
+unsigned long departures = 0;
+
+void setup() {
+  Serial.begin(9600);
+
+  approx.setLocalBSSID(LOCAL_BSSID);
+  approx.setClock(&virtualClock);
+  approx.setProximateDeviceHandler(onProximateDevice, APPROXIMATE_PERSONAL_RSSI);
+
+  const uint8_t *capture = NULL;
+  size_t captureLength = 0;
+  if(mapCapture(capture, captureLength)) replay(capture, captureLength);
+  else Serial.println("No capture found");
+}
+
+void loop() {
+}
+
+bool mapCapture(const uint8_t *&capture, size_t &captureLength) {
+  bool success = false;
+
+  #if defined(ESP32)
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "capture");
+    spi_flash_mmap_handle_t handle;
+    if(partition && esp_partition_mmap(partition, 0, partition -> size, SPI_FLASH_MMAP_DATA, (const void **) &capture, &handle) == ESP_OK) {
+      captureLength = partition -> size;
+      success = true;
+    }
+  #endif
+
+  return(success);
+}
+
+void replay(const uint8_t *capture, size_t captureLength) {
+  CaptureReader reader;
+  CaptureFrame frame;
+
+  if(reader.begin(capture, captureLength)) {
+    unsigned long startedAtMs = millis();
+
+    while(reader.next(frame)) {
+      //the capture's own timestamps drive the clock, so timeouts behave as they did live:
+      virtualClock.setTimeMs(frame.getTimestampMs());
+      approx.parseFrame(frame.getFrame(), frame.getFrameLength(), frame.getRSSI(), frame.getChannel(), frame.getTimestampMs());
+      approx.loop();
+
+      if(reader.getFrameCount() % 1000 == 0) yield();
+    }
+
+    Serial.printf("Replayed %u frames in %lu ms\t%lu arrivals\t%lu departures\n", reader.getFrameCount(), millis() - startedAtMs, arrivals, departures);
+  }
+  else Serial.println("Not a capture of 802.11 frames");
+}
+
+void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
+  switch (event) {
+    case Approximate::ARRIVE:
+      arrivals++;
+      Serial.printf("ARRIVE\t%s\t%i\n", device -> getMacAddressAsString().c_str(), device -> getRSSI());
+      break;
+    case Approximate::DEPART:
+      departures++;
+      Serial.printf("DEPART\t%s\n", device -> getMacAddressAsString().c_str());
+      break;
+  }
+}
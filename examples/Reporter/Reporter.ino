@@ -0,0 +1,35 @@
+/*
+    Reporter example for the Approximate Library
+    -
+    Send every observation of a nearby device to a collector over UDP - one of several nodes on a site, see the Collector example
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include <Approximate.h>
+Approximate approx;
+Reporter reporter;
+
+const uint16_t NODE_ID = 1;                         //unique to each node on the site
+const IPAddress COLLECTOR_IP_ADDRESS(192, 168, 1, 10);
+const uint16_t COLLECTOR_PORT = 5005;
+
+void setup() {
+    Serial.begin(9600);
+
+    if (approx.init("MyHomeWiFi", "password")) {
+        #if defined(ESP8266)
+            //the ESP8266 can't send while sniffing - so batches go in the uplink windows:
+            approx.setDutyCycle(10000, 2000);
+        #endif
+
+        reporter.begin(COLLECTOR_IP_ADDRESS, COLLECTOR_PORT, NODE_ID);
+        approx.setReporter(&reporter);
+        approx.begin();
+    }
+}
+
+void loop() {
+    approx.loop();
+}
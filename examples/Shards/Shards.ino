@@ -0,0 +1,156 @@
+/*
+    Shards example for the Approximate Library
+    -
+    Check how evenly devices spread across shards, that each device's shard never changes, and that sharded instances together see what one would
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include <Approximate.h>
+
+const int SHARD_COUNT = 4;
+const int ADDRESS_COUNT = 10000;
+const int BALANCE_TOLERANCE_PERCENT = 10;   //allowed difference of any shard from an even share
+
+const int STATION_COUNT = 96;
+const int FRAMES_PER_SECOND = 24;
+const uint32_t REPLAY_SECONDS = 6 * 3600;
+
+//known addresses and their shard of four - nodes and collectors of different versions must agree on these:
+const uint64_t KNOWN_ADDRESSES[] = {0x001122334455ULL, 0xA4CF12000001ULL, 0xDA0B6C9E1F22ULL, 0xFFFFFFFFFFFEULL};
+const int KNOWN_SHARDS[] = {3, 3, 2, 1};
+
+TrafficGenerator generator;
+Clock replayClock;
+Approximate single;
+Approximate shards[SHARD_COUNT];
+
+int currentShard = -1;                      //the instance being passed a frame, -1 for the single one
+unsigned long singleArrivals = 0;
+unsigned long shardArrivals[SHARD_COUNT];
+unsigned long misplacedArrivals = 0;
+
+void setup() {
+  Serial.begin(9600);
+  randomSeed(1);
+
+  bool passed = true;
+  passed = checkStability() && passed;
+  passed = checkBalance("random addresses", false) && passed;
+  passed = checkBalance("sequential addresses of one vendor", true) && passed;
+  passed = checkReplay() && passed;
+
+  Serial.println(passed ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
+
+bool checkStability() {
+  bool passed = true;
+
+  for(int n = 0; n < sizeof(KNOWN_ADDRESSES) / sizeof(KNOWN_ADDRESSES[0]); ++n) {
+    int shardIndex = Device::getShardIndex(KNOWN_ADDRESSES[n], SHARD_COUNT);
+    if(shardIndex != KNOWN_SHARDS[n]) {
+      Serial.printf("FAIL - %012llx is in shard %i, not %i\n", (unsigned long long) KNOWN_ADDRESSES[n], shardIndex, KNOWN_SHARDS[n]);
+      passed = false;
+    }
+  }
+
+  return(passed);
+}
+
+bool checkBalance(const char *title, bool sequential) {
+  unsigned long counts[SHARD_COUNT];
+  memset(counts, 0, sizeof(counts));
+
+  uint64_t base = ((uint64_t) random(0x1000000) << 24) & 0xFCFFFF000000ULL;
+  for(int n = 0; n < ADDRESS_COUNT; ++n) {
+    uint64_t macAddressKey = sequential ? base + n : (((uint64_t) random(0x1000000) << 24) | random(0x1000000)) & 0xFEFFFFFFFFFFULL;
+    counts[Device::getShardIndex(macAddressKey, SHARD_COUNT)]++;
+  }
+
+  unsigned long evenShare = ADDRESS_COUNT / SHARD_COUNT;
+  unsigned long worstDifference = 0;
+  Serial.printf("%s:", title);
+  for(int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex) {
+    Serial.printf("\t%lu", counts[shardIndex]);
+    unsigned long difference = counts[shardIndex] > evenShare ? counts[shardIndex] - evenShare : evenShare - counts[shardIndex];
+    worstDifference = max(worstDifference, difference);
+  }
+  Serial.printf("\t(worst %lu%% from even)\n", (worstDifference * 100) / evenShare);
+
+  bool passed = (worstDifference * 100) <= (evenShare * BALANCE_TOLERANCE_PERCENT);
+  if(!passed) Serial.printf("FAIL - %s are not spread evenly\n", title);
+
+  return(passed);
+}
+
+bool checkReplay() {
+  generator.init(STATION_COUNT);
+
+  eth_addr localBSSID;
+  generator.getBssid(0, localBSSID);
+
+  single.setLocalBSSID(localBSSID);
+  single.setClock(&replayClock);
+  single.setProximateDeviceHandler(onProximateDevice, APPROXIMATE_PUBLIC_RSSI, /*lastSeenTimeoutMs*/ 120000);
+
+  for(int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex) {
+    shards[shardIndex].setLocalBSSID(localBSSID);
+    shards[shardIndex].setClock(&replayClock);
+    shards[shardIndex].setShard(shardIndex, SHARD_COUNT);
+    shards[shardIndex].setProximateDeviceHandler(onProximateDevice, APPROXIMATE_PUBLIC_RSSI, /*lastSeenTimeoutMs*/ 120000);
+    shardArrivals[shardIndex] = 0;
+  }
+
+  //every instance is passed every frame:
+  replayClock.setTimeMs(1);
+  for(uint32_t s = 0; s < REPLAY_SECONDS; ++s) {
+    for(int n = 0; n < FRAMES_PER_SECOND; ++n) {
+      uint16_t len;
+      int type;
+      wifi_promiscuous_pkt_t *pkt = generator.next(replayClock.getTimeMs(), len, type);
+
+      currentShard = -1;
+      single.parsePacket(pkt, len, type);
+      for(currentShard = 0; currentShard < SHARD_COUNT; ++currentShard) {
+        shards[currentShard].parsePacket(pkt, len, type);
+      }
+    }
+    replayClock.advanceMs(1000);
+
+    currentShard = -1;
+    single.loop();
+    for(currentShard = 0; currentShard < SHARD_COUNT; ++currentShard) {
+      shards[currentShard].loop();
+    }
+    yield();
+  }
+
+  unsigned long totalShardArrivals = 0;
+  Serial.printf("arrivals by shard:");
+  for(int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex) {
+    Serial.printf("\t%lu", shardArrivals[shardIndex]);
+    totalShardArrivals += shardArrivals[shardIndex];
+  }
+  Serial.printf("\t(%lu in all, %lu unsharded)\n", totalShardArrivals, singleArrivals);
+
+  //rotated addresses are only linked within a shard, so the shards may count a few more:
+  bool passed = misplacedArrivals == 0 && totalShardArrivals >= singleArrivals;
+  if(misplacedArrivals > 0) Serial.printf("FAIL - %lu devices arrived in the wrong shard\n", misplacedArrivals);
+  if(totalShardArrivals < singleArrivals) Serial.println("FAIL - the shards missed devices");
+
+  return(passed);
+}
+
+void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
+  if(event == Approximate::ARRIVE) {
+    if(currentShard < 0) singleArrivals++;
+    else {
+      shardArrivals[currentShard]++;
+      if(Device::getShardIndex(device -> getMacAddressKey(), SHARD_COUNT) != currentShard) misplacedArrivals++;
+    }
+  }
+}
@@ -0,0 +1,113 @@
+/*
+    Soak example for the Approximate Library
+    -
+    Run weeks of simulated traffic and device churn through the pipeline on a virtual clock - fail if the heap or throughput degrade
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include <Approximate.h>
+Approximate approx;
+Clock virtualClock;
+
+const int SOAK_DAYS = 14;
+const int STATION_COUNT = 96;               //more than APPROXIMATE_MAX_DEVICES, so the tables fill
+const int FRAMES_PER_SECOND = 24;
+const int HEAP_TOLERANCE_BYTES = 1024;      //allowed fall in the heap low-water mark after the first day
+const int THROUGHPUT_TOLERANCE_PERCENT = 20; //allowed fall in throughput from the first day, two days running
+
+TrafficGenerator generator;
+
+unsigned long arrivals = 0;
+unsigned long departures = 0;
+
+void setup() {
+  Serial.begin(9600);
+  randomSeed(1);
+
+  generator.init(STATION_COUNT);
+
+  eth_addr localBSSID;
+  generator.getBssid(0, localBSSID);
+  approx.setLocalBSSID(localBSSID);
+  approx.setClock(&virtualClock);
+  approx.setProximateDeviceHandler(onProximateDevice, APPROXIMATE_PUBLIC_RSSI, /*lastSeenTimeoutMs*/ 120000);
+  approx.setActiveDeviceHandler(onActiveDevice);
+
+  approx.printSizeReport();
+  soak();
+}
+
+void loop() {
+}
+
+void soak() {
+  uint32_t warmedUpMinFreeHeapBytes = 0;
+  unsigned long firstDayPacketsPerSecond = 0;
+  bool slowDay = false;
+  bool passed = true;
+
+  virtualClock.setTimeMs(1);
+  for(int day = 1; day <= SOAK_DAYS && passed; ++day) {
+    uint64_t busyUs = 0;
+    unsigned long startPacketCount = approx.getObservedPacketCount();
+
+    for(uint32_t s = 0; s < 24 * 3600; ++s) {
+      unsigned long startedAtUs = micros();
+      for(int n = 0; n < FRAMES_PER_SECOND; ++n) {
+        uint16_t len;
+        int type;
+        wifi_promiscuous_pkt_t *pkt = generator.next(virtualClock.getTimeMs(), len, type);
+        approx.parsePacket(pkt, len, type);
+      }
+      virtualClock.advanceMs(1000);
+      approx.loop();
+      busyUs += micros() - startedAtUs;
+
+      //every simulated second, so that the watchdog is fed - outside the time measured:
+      yield();
+    }
+
+    unsigned long packetsPerSecond = (unsigned long) (((uint64_t) (approx.getObservedPacketCount() - startPacketCount) * 1000000) / max(busyUs, (uint64_t) 1));
+
+    Serial.printf("Day %i\t%lu packets/s\t%i stations present\t%lu arrivals\t%lu departures\n", day, packetsPerSecond, generator.getPresentStationCount(virtualClock.getTimeMs()), arrivals, departures);
+    approx.printHealthReport();
+
+    if(day == 1) {
+      warmedUpMinFreeHeapBytes = approx.getMinFreeHeapBytes();
+      firstDayPacketsPerSecond = packetsPerSecond;
+    }
+    else {
+      if(approx.getMinFreeHeapBytes() + HEAP_TOLERANCE_BYTES < warmedUpMinFreeHeapBytes) {
+        Serial.println("FAIL - heap use is still growing");
+        passed = false;
+      }
+      //one slow day may be noise:
+      bool wasSlowDay = slowDay;
+      slowDay = packetsPerSecond * 100 < firstDayPacketsPerSecond * (100 - THROUGHPUT_TOLERANCE_PERCENT);
+      if(slowDay && wasSlowDay) {
+        Serial.println("FAIL - throughput has degraded");
+        passed = false;
+      }
+    }
+  }
+
+  if(passed) Serial.println("PASS");
+}
+
+void onProximateDevice(Device *device, Approximate::DeviceEvent event) {
+  switch (event) {
+    case Approximate::ARRIVE:
+      arrivals++;
+      approx.addActiveDeviceFilter(device);
+      break;
+    case Approximate::DEPART:
+      departures++;
+      approx.removeActiveDeviceFilter(device);
+      break;
+  }
+}
+
+void onActiveDevice(Device *device, Approximate::DeviceEvent event) {
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+    allowlist.py
+    Approximate Library
+    -
+    Build an Allowlist blob from a file of MAC addresses, one per line - as a C header holding a PROGMEM array, or as raw bytes to write to a flash partition
+    -
+    python3 allowlist.py macs.txt allowlist.h [--rate 0.01] [--name ALLOWLIST]
+    python3 allowlist.py macs.txt allowlist.bin [--rate 0.01]
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+"""
+
+import argparse
+import math
+import struct
+
+MAGIC = 0x46425041
+HEADER_LENGTH_BYTES = 16
+MAX_HASH_COUNT = 16
+MASK_64 = (1 << 64) - 1
+MASK_32 = (1 << 32) - 1
+
+
+def mac_address_key(text):
+    #the first octet most significant, as eth_addr_to_uint64():
+    return int(text.strip().replace(':', '').replace('-', ''), 16)
+
+
+def mac_address_hash(key):
+    #as Device::getMacAddressHash() - the splitmix64 finaliser:
+    key ^= key >> 30
+    key = (key * 0xBF58476D1CE4E5B9) & MASK_64
+    key ^= key >> 27
+    key = (key * 0x94D049BB133111EB) & MASK_64
+    key ^= key >> 31
+    return key
+
+
+def build(keys, rate):
+    #as Allowlist::getLengthBytes() and Allowlist::build():
+    p = min(max(rate, 0.0001), 0.5)
+    bit_count = math.ceil(-max(len(keys), 1) * math.log(p) / (math.log(2) ** 2))
+    bit_count = ((bit_count + 7) // 8) * 8
+    hash_count = min(max(int(round((bit_count / max(len(keys), 1)) * math.log(2))), 1), MAX_HASH_COUNT)
+
+    bits = bytearray(bit_count // 8)
+    for key in keys:
+        h = mac_address_hash(key)
+        h1 = h & MASK_32
+        h2 = (h >> 32) | 1
+        for n in range(hash_count):
+            i = ((h1 + n * h2) & MASK_32) % bit_count
+            bits[i >> 3] |= 1 << (i & 7)
+
+    return struct.pack('<IIIB3x', MAGIC, bit_count, len(keys), hash_count) + bytes(bits)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build an Approximate Allowlist blob')
+    parser.add_argument('macs')
+    parser.add_argument('out')
+    parser.add_argument('--rate', type=float, default=0.01, help='the false positive rate wanted')
+    parser.add_argument('--name', default='ALLOWLIST', help='the name of the array in a header')
+    args = parser.parse_args()
+
+    with open(args.macs) as f:
+        keys = sorted(set(mac_address_key(line) for line in f if line.strip() and not line.startswith('#')))
+    blob = build(keys, args.rate)
+
+    if args.out.endswith('.h'):
+        with open(args.out, 'w') as f:
+            f.write('//%i MAC addresses - built by allowlist.py\n' % len(keys))
+            f.write('const uint8_t %s[] PROGMEM = {\n' % args.name)
+            for n in range(0, len(blob), 16):
+                f.write('  ' + ', '.join('0x%02X' % b for b in blob[n:n + 16]) + ',\n')
+            f.write('};\n')
+    else:
+        with open(args.out, 'wb') as f:
+            f.write(blob)
+
+    print('%i MAC addresses in %i bytes' % (len(keys), len(blob)))
+
+
+if __name__ == '__main__':
+    main()
@@ -8,30 +8,20 @@
 
 #include "Approximate.h"
 
-bool Approximate::running = false;
-
-PacketSniffer *Approximate::packetSniffer = PacketSniffer::getInstance();
-ArpTable *Approximate::arpTable = NULL;
-
-Approximate::DeviceHandler Approximate::activeDeviceHandler = NULL;
-Approximate::DeviceHandler Approximate::proximateDeviceHandler = NULL;
-Approximate::ChannelStateHandler Approximate::channelStateHandler = NULL;
-
-eth_addr Approximate::ownMacAddress = {{0,0,0,0,0,0}};
-
-int Approximate::proximateRSSIThreshold = APPROXIMATE_PERSONAL_RSSI;
-eth_addr Approximate::localBSSID = {{0,0,0,0,0,0}};
-List<Filter *> Approximate::activeDeviceFilterList;
-
-List<Device *> Approximate::proximateDeviceList;
-int Approximate::proximateLastSeenTimeoutMs = 60000;
-
 Approximate::Approximate() {
+  packetSniffer = PacketSniffer::getInstance();
+  packetSniffer -> addPacketEventHandler(onPacketEvent, this);
+
   uint8_t ma[6];
   WiFi.macAddress(ma);          
   uint8_t_to_eth_addr(ma, ownMacAddress);
 }
 
+Approximate::~Approximate() {
+  packetSniffer -> removePacketEventHandler(onPacketEvent, this);
+  packetSniffer -> removeChannelEventHandler(onChannelEvent, this);
+}
+
 bool Approximate::init() {
   bool success = false;
 
@@ -50,6 +40,14 @@ bool Approximate::init() {
 bool Approximate::init(String ssid, String password, bool ipAddressResolution, bool csiEnabled) {
   bool success = false;
 
+  if(fastReconnect && connectionCache.channel > 0) {
+    //the channel and BSSID are already known - no need to scan:
+    strcpy(this->ssid, ssid.c_str());
+    strcpy(this->password, password.c_str());
+
+    return(init(connectionCache.channel, connectionCache.bssid, ipAddressResolution, csiEnabled));
+  }
+
   int n = WiFi.scanNetworks();
   for (int i = 0; i < n && !success; ++i) {
     if(WiFi.SSID(i) == ssid) {
@@ -77,104 +75,132 @@ bool Approximate::init(int channel, uint8_t *bssid, bool ipAddressResolution, bo
   delay(100);
 
   packetSniffer -> init(channel);
-  packetSniffer -> setPacketEventHandler(parsePacket);
-  if(csiEnabled) packetSniffer -> setChannelEventHandler(parseChannelStateInformation);
+  packetSniffer -> addPacketEventHandler(onPacketEvent, this);
+  if(csiEnabled) packetSniffer -> addChannelEventHandler(onChannelEvent, this);
+
+  connectionCache.channel = channel;
+  memcpy(connectionCache.bssid, bssid, sizeof(connectionCache.bssid));
 
   eth_addr networkBSSID; 
   uint8_t_to_eth_addr(bssid, networkBSSID);
   setLocalBSSID(networkBSSID);
 
-  String networkBSSIDAsString;
-  eth_addr_to_String(networkBSSID, networkBSSIDAsString);
-  Serial.printf("\n-\nRouter: %s\t\tChannel: %i\n-\n", networkBSSIDAsString.c_str(), channel);
+  char networkBSSIDAs_c_str[18];
+  eth_addr_to_c_str(networkBSSID, networkBSSIDAs_c_str);
+  Serial.printf("\n-\nRouter: %s\t\tChannel: %i\n-\n", networkBSSIDAs_c_str, channel);
 
-  if(ipAddressResolution) arpTable = ArpTable::getInstance();
+  #if APPROXIMATE_ARP_ENABLED
+    if(ipAddressResolution) arpTable = &localArpTable;
+  #endif
 
   return(success);
 }
 
-void Approximate::onceWifiStatus(wl_status_t status, voidFnPtr callBackFnPtr) {
+Continuation *Approximate::queueContinuation(wl_status_t status) {
+  Continuation *continuation = NULL;
+
   if(status != WL_IDLE_STATUS) {
-    if(WiFi.status() == status) {
-      callBackFnPtr();
-      triggerWifiStatus = WL_IDLE_STATUS;
-    }
-    else {
-      this -> triggerWifiStatus = status;
-      this -> onceWifiStatusFnPtr = callBackFnPtr;
+    for(int n = 0; n < maxContinuations && !continuation; ++n) {
+      if(!continuations[n].isPending()) continuation = &continuations[n];
     }
+
+    if(!continuation) Serial.println("Approximate::onceWifiStatus queue full");
   }
+
+  return(continuation);
 }
 
-void Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithStringPayload callBackFnPtr, String payload) {
-  if(status != WL_IDLE_STATUS) {
-    if(WiFi.status() == status) {
-      callBackFnPtr(payload);
-      triggerWifiStatus = WL_IDLE_STATUS;
-    }
-    else {
-      this -> triggerWifiStatus = status;
-      this -> onceWifiStatusWithStringPayloadFnPtr = callBackFnPtr;
-      this -> onceWifiStatusStringPayload = payload;
-    }
+void Approximate::runContinuations(wl_status_t status) {
+  //callbacks queued while running are picked up by this same pass:
+  if(!runningContinuations) {
+    runningContinuations = true;
+
+    Continuation *next = NULL;
+    do {
+      next = NULL;
+      for(int n = 0; n < maxContinuations; ++n) {
+        if(continuations[n].isPending(status) && (!next || continuations[n].getSequence() < next -> getSequence())) {
+          next = &continuations[n];
+        }
+      }
+      if(next) next -> invoke();
+    } while(next);
+
+    runningContinuations = false;
   }
 }
 
-void Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithBoolPayload callBackFnPtr, bool payload) {
-  if(status != WL_IDLE_STATUS) {
-    if(WiFi.status() == status) {
-      callBackFnPtr(payload);
-      triggerWifiStatus = WL_IDLE_STATUS;
-    }
-    else {
-      this -> triggerWifiStatus = status;
-      this -> onceWifiStatusWithBoolPayloadFnPtr = callBackFnPtr;
-      this -> onceWifiStatusBoolPayload = payload;
-    }
+template<typename Payload>
+bool Approximate::queueOnceWifiStatus(wl_status_t status, void (*callBackFnPtr)(Payload), const Payload &payload) {
+  Continuation *continuation = queueContinuation(status);
+
+  if(continuation) {
+    continuation -> init(status, continuationSequence++, callBackFnPtr, payload);
+    if(WiFi.status() == status) runContinuations(status);
   }
+
+  return(continuation != NULL);
 }
 
-void Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithFnPtrPayload callBackFnPtr, voidFnPtr payload) {
-  if(status != WL_IDLE_STATUS) {
-    if(WiFi.status() == status) {
-      callBackFnPtr(payload);
-      triggerWifiStatus = WL_IDLE_STATUS;
-    }
-    else {
-      this -> triggerWifiStatus = status;
-      this -> onceWifiStatusWithFnPtrPayloadFnPtr = callBackFnPtr;
-      this -> onceWifiStatusFnPtrPayload = payload;
-    }
+bool Approximate::onceWifiStatus(wl_status_t status, voidFnPtr callBackFnPtr) {
+  Continuation *continuation = queueContinuation(status);
+
+  if(continuation) {
+    continuation -> init(status, continuationSequence++, callBackFnPtr);
+    if(WiFi.status() == status) runContinuations(status);
   }
+
+  return(continuation != NULL);
+}
+
+#if APPROXIMATE_STRING_API_ENABLED
+bool Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithStringPayload callBackFnPtr, String payload) {
+  return(queueOnceWifiStatus(status, callBackFnPtr, payload));
+}
+#endif
+
+bool Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithBoolPayload callBackFnPtr, bool payload) {
+  return(queueOnceWifiStatus(status, callBackFnPtr, payload));
+}
+
+bool Approximate::onceWifiStatus(wl_status_t status, voidFnPtrWithFnPtrPayload callBackFnPtr, voidFnPtr payload) {
+  return(queueOnceWifiStatus(status, callBackFnPtr, payload));
 }
 
 void Approximate::begin(voidFnPtr thenFnPtr) {
   Serial.println("Approximate::begin");
 
-  onceWifiStatus(WL_CONNECTED, [](voidFnPtr thenFnPtr) {
-    if(thenFnPtr) thenFnPtr();
+  BeginContext beginContext = {this, thenFnPtr};
+  queueOnceWifiStatus(WL_CONNECTED, onBeginConnected, beginContext);
+  windowStartedAtMs = dutyCycleUpdatedAtMs = millis();
+  connectWiFi();
+  Serial.println("Approximate::begin DONE");
+}
 
-    if(arpTable) {
-      arpTable -> scan(); //blocking
-      arpTable -> begin();
-    }
+void Approximate::onBeginConnected(BeginContext beginContext) {
+  Approximate *approximate = beginContext.approximate;
 
-    #if defined(ESP8266)
-      WiFi.disconnect();
-    #endif
+  if(beginContext.thenFnPtr) beginContext.thenFnPtr();
 
-    //start the packetSniffer after the scan is complete:
-    if(packetSniffer)  packetSniffer -> begin();
+  #if APPROXIMATE_ARP_ENABLED
+    if(approximate -> arpTable) approximate -> arpTable -> begin();
+  #endif
 
-    running = true;
-  }, thenFnPtr);
-  connectWiFi();
-  Serial.println("Approximate::begin DONE");
+  #if defined(ESP8266)
+    WiFi.disconnect();
+  #endif
+
+  //start the packetSniffer once the ARP table has read what lwIP knows:
+  if(approximate -> packetSniffer)  approximate -> packetSniffer -> begin();
+
+  approximate -> running = true;
 }
 
 void Approximate::end() {
   if (packetSniffer)  packetSniffer -> end();
-  if (arpTable)       arpTable -> end();
+  #if APPROXIMATE_ARP_ENABLED
+    if (arpTable)     arpTable -> end();
+  #endif
 
   running = false;
 }
@@ -185,11 +211,34 @@ void Approximate::loop() {
       packetSniffer -> loop();
     }
 
-    if (arpTable)       arpTable -> loop();
+    #if APPROXIMATE_ARP_ENABLED
+      if (arpTable) {
+        resolveIPAddresses();
+        arpTable -> loop();
+      }
+    #endif
 
     updateProximateDeviceList(); 
+    updateDutyCycle();
+  }
+  else if(clock -> isVirtual()) {
+    //replaying - time only moves with the clock:
+    updateProximateDeviceList();
   }
 
+  updateHealth();
+
+  #if APPROXIMATE_REPORTER_ENABLED
+    if(reporter) {
+      //observations waiting to be sent need the next uplink window:
+      if(isDutyCycled() && !uplinkWindowOpen && reporter -> isPending()) uplinkRequested = true;
+      reporter -> loop();
+    }
+  #endif
+  #if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+    if(trafficCounter) trafficCounter -> loop(clock -> getTimeMs());
+  #endif
+
   if(currentWifiStatus != WiFi.status()) {
     printWiFiStatus();
     wl_status_t lastWifiStatus = currentWifiStatus;
@@ -203,48 +252,62 @@ bool Approximate::isRunning() {
 }
 
 void Approximate::onWifiStatusChange(wl_status_t oldStatus, wl_status_t newStatus) {
-  if(newStatus != WL_IDLE_STATUS && newStatus == triggerWifiStatus) {
-    if(onceWifiStatusFnPtr != NULL ) {
-      onceWifiStatusFnPtr();
-    }
-    else if(onceWifiStatusWithStringPayloadFnPtr != NULL) {
-      onceWifiStatusWithStringPayloadFnPtr(onceWifiStatusStringPayload);
-    }
-    else if(onceWifiStatusWithBoolPayloadFnPtr != NULL) {
-      onceWifiStatusWithBoolPayloadFnPtr(onceWifiStatusBoolPayload);
-    }
-    else if(onceWifiStatusWithFnPtrPayloadFnPtr != NULL) {
-      onceWifiStatusWithFnPtrPayloadFnPtr(onceWifiStatusFnPtrPayload);
-    }
+  if(newStatus == WL_CONNECTED) onReconnected();
+  else if(newStatus == WL_CONNECT_FAILED || newStatus == WL_NO_SSID_AVAIL) onConnectFailed();
 
-    onceWifiStatusFnPtr = NULL;
-    onceWifiStatusWithStringPayloadFnPtr = NULL;
-    onceWifiStatusWithFnPtrPayloadFnPtr = NULL;
-    triggerWifiStatus = WL_IDLE_STATUS;
-  }
+  if(newStatus != WL_IDLE_STATUS) runContinuations(newStatus);
 }
 
 wl_status_t Approximate::connectWiFi() {
   return(connectWiFi(this -> ssid, this -> password));
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 wl_status_t Approximate::connectWiFi(String ssid, String password) {
   connectWiFi(ssid.c_str(), password.c_str());
 }
+#endif
 
 wl_status_t Approximate::connectWiFi(char *ssid, char *password) {
+  if(isDutyCycled() && !uplinkWindowOpen) {
+    //wait for the next uplink window:
+    uplinkRequested = true;
+    return(WiFi.status());
+  }
+
   Serial.printf("Approximate::connectWiFi %s %s\n", ssid, password);
 
   if(WiFi.status() != WL_CONNECTED) {
     if(strlen(ssid) > 0) {
       #if defined(ESP8266)
         if (packetSniffer)  packetSniffer -> end();
-        WiFi.begin(ssid, password);
+        connectWiFiStartedAtMs = millis();
+
+        if(fastReconnect && connectionCache.channel > 0) {
+          if(isCachedLeaseReusable()) {
+            WiFi.config(IPAddress(connectionCache.localIP), IPAddress(connectionCache.gatewayIP), IPAddress(connectionCache.subnetMask), IPAddress(connectionCache.dnsIP));
+            usingCachedLease = true;
+          }
+          else if(usingCachedLease) {
+            //back to DHCP:
+            WiFi.config(IPAddress(0U), IPAddress(0U), IPAddress(0U));
+            usingCachedLease = false;
+          }
+          WiFi.begin(ssid, password, connectionCache.channel, connectionCache.bssid);
+        }
+        else {
+          WiFi.begin(ssid, password);
+        }
 
       #elif defined(ESP32)
         //WiFi.begin() for the ESP32 (1.0.4) > https://github.com/espressif/arduino-esp32/blob/master/libraries/WiFi/src/WiFiSTA.cpp - doesn't call esp_wifi_init() or esp_wifi_start() - which are needed later for esp_wifi_set_csi()
-        tcpip_adapter_init();
-        esp_event_loop_init(NULL, NULL);
+        bool fastReconnectAvailable = fastReconnect && connectionCache.channel > 0;
+        connectWiFiStartedAtMs = millis();
+
+        if(!(fastReconnectAvailable && wifiInitialised)) {
+          tcpip_adapter_init();
+          esp_event_loop_init(NULL, NULL);
+        }
 
         if(!WiFi.enableSTA(true)) {
             log_e("STA enable failed!");
@@ -262,8 +325,11 @@ wl_status_t Approximate::connectWiFi(char *ssid, char *password) {
 
         }
 
-        wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-        esp_wifi_init(&cfg);
+        if(!(fastReconnectAvailable && wifiInitialised)) {
+          wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+          esp_wifi_init(&cfg);
+          wifiInitialised = true;
+        }
 
         wifi_config_t conf;
         memset(&conf, 0, sizeof(wifi_config_t));
@@ -277,13 +343,24 @@ wl_status_t Approximate::connectWiFi(char *ssid, char *password) {
             }
         }
 
+        if(fastReconnectAvailable) {
+            conf.sta.channel = connectionCache.channel;
+            conf.sta.bssid_set = 1;
+            memcpy(conf.sta.bssid, connectionCache.bssid, sizeof(conf.sta.bssid));
+        }
+
         if(esp_wifi_disconnect()){
             log_e("disconnect failed!");
             return WL_CONNECT_FAILED;
         }
         esp_wifi_set_config(WIFI_IF_STA, &conf);
 
-        if(tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA) == ESP_ERR_TCPIP_ADAPTER_DHCPC_START_FAILED){
+        usingCachedLease = fastReconnectAvailable && isCachedLeaseReusable();
+        if(usingCachedLease) {
+            //reuse the last DHCP lease:
+            WiFi.config(IPAddress(connectionCache.localIP), IPAddress(connectionCache.gatewayIP), IPAddress(connectionCache.subnetMask), IPAddress(connectionCache.dnsIP));
+        }
+        else if(tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA) == ESP_ERR_TCPIP_ADAPTER_DHCPC_START_FAILED){
             log_e("dhcp client start failed!");
             return WL_CONNECT_FAILED;
         }
@@ -303,6 +380,9 @@ wl_status_t Approximate::connectWiFi(char *ssid, char *password) {
 }
 
 void Approximate::disconnectWiFi() {
+  //within an uplink window the disconnection is left to the duty cycle:
+  if(isDutyCycled() && uplinkWindowOpen) return;
+
   WiFi.disconnect();
 
   #if defined(ESP8266)
@@ -310,6 +390,245 @@ void Approximate::disconnectWiFi() {
   #endif
 }
 
+void Approximate::setDutyCycle(unsigned long sniffWindowMs, unsigned long uplinkWindowMs) {
+  this -> sniffWindowMs = sniffWindowMs;
+  this -> uplinkWindowMs = uplinkWindowMs;
+}
+
+bool Approximate::isDutyCycled() {
+  return(running && sniffWindowMs > 0);
+}
+
+void Approximate::updateDutyCycle() {
+  unsigned long now = millis();
+
+  //account for time spent unable to observe packets:
+  if(packetSniffer && packetSniffer -> isRunning())  sniffingMs += now - dutyCycleUpdatedAtMs;
+  else                                              blindMs += now - dutyCycleUpdatedAtMs;
+  dutyCycleUpdatedAtMs = now;
+
+  if(isDutyCycled()) {
+    if(!uplinkWindowOpen) {
+      if(uplinkRequested && (now - windowStartedAtMs) >= sniffWindowMs) {
+        uplinkWindowOpen = true;
+        uplinkRequested = false;
+        uplinkConnectedAtMs = 0;
+        windowStartedAtMs = now;
+        connectWiFi();
+      }
+    }
+    else {
+      bool connected = (WiFi.status() == WL_CONNECTED);
+      if(connected && uplinkConnectedAtMs == 0) uplinkConnectedAtMs = now;
+
+      bool uplinkComplete = connected && (now - uplinkConnectedAtMs) >= uplinkWindowMs;
+      bool uplinkFailed = !connected && (now - windowStartedAtMs) > uplinkConnectTimeoutMs;
+
+      if(uplinkComplete || uplinkFailed) {
+        //on failure try again after the next sniff window:
+        if(uplinkFailed) {
+          uplinkRequested = true;
+          onConnectFailed();
+        }
+
+        uplinkWindowOpen = false;
+        windowStartedAtMs = now;
+        disconnectWiFi();
+      }
+    }
+  }
+}
+
+float Approximate::getBlindTimeRatio() {
+  unsigned long totalMs = sniffingMs + blindMs;
+
+  return(totalMs > 0 ? (float) blindMs / totalMs : 0.0);
+}
+
+unsigned long Approximate::getLostObservationEstimate() {
+  //assume packets arrive while blind at the rate they were observed while sniffing:
+  return(sniffingMs > 0 ? (unsigned long) (((float) observedPacketCount * blindMs) / sniffingMs) : 0);
+}
+
+void Approximate::setFastReconnect(bool fastReconnect, unsigned long maxLeaseAgeMs) {
+  this -> fastReconnect = fastReconnect;
+  this -> maxLeaseAgeMs = maxLeaseAgeMs;
+}
+
+bool Approximate::isCachedLeaseReusable() {
+  return(connectionCache.localIP != 0 && (millis() - leaseObtainedAtMs) < maxLeaseAgeMs);
+}
+
+void Approximate::onConnectFailed() {
+  //the lease may have been given to another device - ask DHCP next time:
+  if(usingCachedLease) {
+    connectionCache.localIP = 0;
+    usingCachedLease = false;
+  }
+}
+
+bool Approximate::getConnectionCache(ConnectionCache &connectionCache) {
+  this -> connectionCache.leaseAgeMs = millis() - leaseObtainedAtMs;
+  connectionCache = this -> connectionCache;
+
+  return(connectionCache.channel > 0);
+}
+
+void Approximate::setConnectionCache(ConnectionCache &connectionCache) {
+  this -> connectionCache = connectionCache;
+  leaseObtainedAtMs = millis() - connectionCache.leaseAgeMs;
+}
+
+void Approximate::updateConnectionCache() {
+  connectionCache.channel = WiFi.channel();
+  memcpy(connectionCache.bssid, WiFi.BSSID(), sizeof(connectionCache.bssid));
+  connectionCache.localIP = (uint32_t) WiFi.localIP();
+  connectionCache.gatewayIP = (uint32_t) WiFi.gatewayIP();
+  connectionCache.subnetMask = (uint32_t) WiFi.subnetMask();
+  connectionCache.dnsIP = (uint32_t) WiFi.dnsIP();
+}
+
+void Approximate::onReconnected() {
+  if(connectWiFiStartedAtMs > 0) {
+    lastReconnectLatencyMs = millis() - connectWiFiStartedAtMs;
+    connectWiFiStartedAtMs = 0;
+
+    int bin = 0;
+    while(bin < reconnectLatencyBinCount - 1 && lastReconnectLatencyMs >= getReconnectLatencyBinUpperMs(bin)) bin++;
+    reconnectLatencyHistogram[bin]++;
+  }
+
+  //a new lease unless the cached one was reused:
+  if(!usingCachedLease) leaseObtainedAtMs = millis();
+  updateConnectionCache();
+}
+
+unsigned long Approximate::getLastReconnectLatencyMs() {
+  return(lastReconnectLatencyMs);
+}
+
+int Approximate::getReconnectLatencyCount(int bin) {
+  int count = 0;
+
+  if(bin >= 0 && bin < reconnectLatencyBinCount) count = reconnectLatencyHistogram[bin];
+
+  return(count);
+}
+
+unsigned long Approximate::getReconnectLatencyBinUpperMs(int bin) {
+  //128ms, 256ms ... 8192ms, the last bin is unbounded:
+  return(bin < reconnectLatencyBinCount - 1 ? (128UL << bin) : ~0UL);
+}
+
+void Approximate::printReconnectLatencyHistogram() {
+  for(int bin = 0; bin < reconnectLatencyBinCount; ++bin) {
+    if(bin < reconnectLatencyBinCount - 1)  Serial.printf("<%lums\t%i\n", getReconnectLatencyBinUpperMs(bin), reconnectLatencyHistogram[bin]);
+    else                                    Serial.printf(">=%lums\t%i\n", getReconnectLatencyBinUpperMs(bin - 1), reconnectLatencyHistogram[bin]);
+  }
+}
+
+void Approximate::printSizeReport() {
+  Serial.printf("Approximate configuration:\n");
+  Serial.printf("APPROXIMATE_MAX_DEVICES\t%i\t%i bytes\n", APPROXIMATE_MAX_DEVICES, (int) (sizeof(proximateDevicePool) + sizeof(proximateDeviceStates) + sizeof(proximateDeviceList) + sizeof(nearestDeviceList)));
+  Serial.printf("APPROXIMATE_MAX_FILTERS\t%i\t%i bytes\n", APPROXIMATE_MAX_FILTERS, (int) (sizeof(activeDeviceFilterPool) + sizeof(activeDeviceFilterList)));
+  Serial.printf("APPROXIMATE_MAX_CONTINUATIONS\t%i\t%i bytes\n", APPROXIMATE_MAX_CONTINUATIONS, (int) sizeof(continuations));
+  Serial.printf("APPROXIMATE_CSI_ENABLED\t%i\n", APPROXIMATE_CSI_ENABLED);
+  Serial.printf("APPROXIMATE_ARP_ENABLED\t%i\n", APPROXIMATE_ARP_ENABLED);
+  Serial.printf("APPROXIMATE_STRING_API_ENABLED\t%i\n", APPROXIMATE_STRING_API_ENABLED);
+  Serial.printf("APPROXIMATE_RSSI_HISTORY_ENABLED\t%i\n", APPROXIMATE_RSSI_HISTORY_ENABLED);
+  Serial.printf("Approximate instance\t%i bytes\n", (int) sizeof(Approximate));
+  #if APPROXIMATE_RSSI_HISTORY_ENABLED
+    Serial.printf("Device\t%i bytes\tstate %i bytes\tRSSI history %i bytes\n", (int) sizeof(Device), (int) sizeof(DeviceState), (int) sizeof(RSSIHistory));
+  #else
+    Serial.printf("Device\t%i bytes\tstate %i bytes\n", (int) sizeof(Device), (int) sizeof(DeviceState));
+  #endif
+  Serial.printf("APPROXIMATE_REPORTER_ENABLED\t%i\n", APPROXIMATE_REPORTER_ENABLED);
+  Serial.printf("APPROXIMATE_COLLECTOR_ENABLED\t%i\n", APPROXIMATE_COLLECTOR_ENABLED);
+  Serial.printf("APPROXIMATE_OCCUPANCY_ENABLED\t%i\n", APPROXIMATE_OCCUPANCY_ENABLED);
+  Serial.printf("APPROXIMATE_TRAFFIC_COUNTER_ENABLED\t%i\n", APPROXIMATE_TRAFFIC_COUNTER_ENABLED);
+  Serial.printf("APPROXIMATE_ALLOWLIST_ENABLED\t%i\n", APPROXIMATE_ALLOWLIST_ENABLED);
+  Serial.printf("APPROXIMATE_TRAFFIC_GENERATOR_ENABLED\t%i\n", APPROXIMATE_TRAFFIC_GENERATOR_ENABLED);
+  #if APPROXIMATE_REPORTER_ENABLED
+    Serial.printf("Reporter\t%i queued\t%i bytes\n", APPROXIMATE_REPORTER_QUEUE_LENGTH, (int) sizeof(Reporter));
+  #endif
+  #if APPROXIMATE_COLLECTOR_ENABLED
+    Serial.printf("Collector\t%i shards\t%i devices\t%i bytes\n", APPROXIMATE_COLLECTOR_MAX_SHARDS, APPROXIMATE_COLLECTOR_MAX_DEVICES, (int) sizeof(Collector));
+  #endif
+  #if APPROXIMATE_OCCUPANCY_ENABLED
+    Serial.printf("OccupancyCounter\t%i bytes\n", (int) sizeof(OccupancyCounter));
+  #endif
+  #if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+    Serial.printf("TrafficCounter\t%i x %i\ttop %i\t%i bytes\n", TrafficCounter::depth, TrafficCounter::width, TrafficCounter::maxTopCount, (int) sizeof(TrafficCounter));
+  #endif
+}
+
+void Approximate::updateHealth() {
+  uint64_t now = clock -> getTimeMs();
+
+  if(healthSampledAtMs == 0 || (now - healthSampledAtMs) >= healthSampleIntervalMs) {
+    uint32_t freeHeapBytes = getFreeHeapBytes();
+    if(minFreeHeapBytes == 0 || freeHeapBytes < minFreeHeapBytes) minFreeHeapBytes = freeHeapBytes;
+
+    uint8_t heapFragmentation = getHeapFragmentation();
+    if(heapFragmentation > maxHeapFragmentation) maxHeapFragmentation = heapFragmentation;
+
+    if(healthSampledAtMs > 0 && now > healthSampledAtMs) {
+      packetRate = (unsigned long) (((uint64_t) (observedPacketCount - healthSampledPacketCount) * 1000) / (now - healthSampledAtMs));
+    }
+    healthSampledPacketCount = observedPacketCount;
+    healthSampledAtMs = now;
+  }
+}
+
+uint32_t Approximate::getFreeHeapBytes() {
+  return(ESP.getFreeHeap());
+}
+
+uint8_t Approximate::getHeapFragmentation() {
+  uint8_t heapFragmentation = 0;
+
+  //the percentage of free heap outside the largest free block:
+  #if defined(ESP8266)
+    heapFragmentation = ESP.getHeapFragmentation();
+  #elif defined(ESP32)
+    uint32_t freeHeapBytes = ESP.getFreeHeap();
+    if(freeHeapBytes > 0) heapFragmentation = 100 - (uint8_t) (((uint64_t) ESP.getMaxAllocHeap() * 100) / freeHeapBytes);
+  #endif
+
+  return(heapFragmentation);
+}
+
+uint32_t Approximate::getMinFreeHeapBytes() {
+  return(minFreeHeapBytes);
+}
+
+uint8_t Approximate::getMaxHeapFragmentation() {
+  return(maxHeapFragmentation);
+}
+
+unsigned long Approximate::getPacketRate() {
+  return(packetRate);
+}
+
+unsigned long Approximate::getObservedPacketCount() {
+  return(observedPacketCount);
+}
+
+unsigned long Approximate::getDroppedArrivalCount() {
+  return(droppedArrivalCount);
+}
+
+int Approximate::getProximateDeviceCount() {
+  return(proximateDeviceList.Count());
+}
+
+void Approximate::printHealthReport() {
+  Serial.printf("Free heap\t%u bytes\t(low-water %u bytes)\n", (unsigned int) getFreeHeapBytes(), (unsigned int) minFreeHeapBytes);
+  Serial.printf("Heap fragmentation\t%u%%\t(peak %u%%)\n", (unsigned int) getHeapFragmentation(), (unsigned int) maxHeapFragmentation);
+  Serial.printf("Packet rate\t%lu/s\t(%lu observed)\n", packetRate, observedPacketCount);
+  Serial.printf("Proximate devices\t%i/%i\t(%lu arrivals dropped)\n", proximateDeviceList.Count(), proximateDeviceList.Capacity(), droppedArrivalCount);
+}
+
 void Approximate::printWiFiStatus() {
   switch(WiFi.status()) {
     case WL_CONNECTED:        Serial.println("WL_CONNECTED"); break;
@@ -323,12 +642,14 @@ void Approximate::printWiFiStatus() {
   }
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 void Approximate::addActiveDeviceFilter(String macAddress) {
   eth_addr macAddress_eth_addr;
   String_to_eth_addr(macAddress, macAddress_eth_addr);
 
   addActiveDeviceFilter(macAddress_eth_addr);
 }
+#endif
 
 void Approximate::addActiveDeviceFilter(char *macAddress) {
   eth_addr macAddress_eth_addr;
@@ -359,14 +680,19 @@ void Approximate::addActiveDeviceFilter(int oui) {
 }
 
 void Approximate::addActiveDeviceFilter(eth_addr &macAddress) {
-  Filter *f = new Filter(macAddress);
-  activeDeviceFilterList.Add(f);
+  Filter *f = activeDeviceFilterPool.allocate();
+  if(f) {
+    *f = Filter(macAddress);
+    activeDeviceFilterList.Add(f);
+  }
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 void Approximate::setActiveDeviceFilter(String macAddress) {
   removeAllActiveDeviceFilters();
   addActiveDeviceFilter(macAddress);
 }
+#endif
 
 void Approximate::setActiveDeviceFilter(char *macAddress) {
   removeAllActiveDeviceFilters();
@@ -393,12 +719,14 @@ void Approximate::setActiveDeviceFilter(int oui) {
   addActiveDeviceFilter(oui);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 void Approximate::removeActiveDeviceFilter(String macAddress) {
   eth_addr macAddress_eth_addr;
   String_to_eth_addr(macAddress, macAddress_eth_addr);
 
   removeActiveDeviceFilter(macAddress_eth_addr);
 }
+#endif
 
 void Approximate::removeActiveDeviceFilter(Device &device) {
   eth_addr macAddress;
@@ -426,7 +754,7 @@ void Approximate::removeActiveDeviceFilter(eth_addr &macAddress) {
     Filter *thisFilter = activeDeviceFilterList[n];
     if(thisFilter -> matches(&macAddress)) {
       activeDeviceFilterList.Remove(n);
-      delete thisFilter;
+      activeDeviceFilterPool.release(thisFilter);
       n = 0;  //reset the count in case multiple matches
     }
   }
@@ -436,7 +764,7 @@ void Approximate::removeAllActiveDeviceFilters() {
   for (int n = 0; n < activeDeviceFilterList.Count(); n++) {
     Filter *thisFilter = activeDeviceFilterList[n];
     activeDeviceFilterList.Remove(n);
-    delete thisFilter;
+    activeDeviceFilterPool.release(thisFilter);
     n = 0;  //reset
   }
 }
@@ -452,12 +780,14 @@ bool Approximate::applyDeviceFilters(Device *device) {
   return(result);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 void Approximate::setLocalBSSID(String macAddress) {
   eth_addr macAddress_eth_addr;
   String_to_eth_addr(macAddress, macAddress_eth_addr);
 
   setLocalBSSID(macAddress_eth_addr);
 }
+#endif
 
 void Approximate::setLocalBSSID(eth_addr &macAddress) {
   ETHADDR16_COPY(&this -> localBSSID, &macAddress);
@@ -467,132 +797,481 @@ void Approximate::setActiveDeviceHandler(DeviceHandler activeDeviceHandler, bool
   if(!inclusive) {
     addActiveDeviceFilter(Filter::NONE); 
   }
-  Approximate::activeDeviceHandler = activeDeviceHandler;
+  this -> activeDeviceHandler = activeDeviceHandler;
 }
 
 void Approximate::setProximateDeviceHandler(DeviceHandler deviceHandler, int rssiThreshold, int lastSeenTimeoutMs) {
   setProximateRSSIThreshold(rssiThreshold);
   setProximateLastSeenTimeoutMs(lastSeenTimeoutMs);
-  Approximate::proximateDeviceHandler = deviceHandler;
+  this -> proximateDeviceHandler = deviceHandler;
 }
 
 void Approximate::setProximateRSSIThreshold(int proximateRSSIThreshold) {
-  Approximate::proximateRSSIThreshold = proximateRSSIThreshold;
+  this -> proximateRSSIThreshold = proximateRSSIThreshold;
 }
 
 void Approximate::setProximateLastSeenTimeoutMs(int proximateLastSeenTimeoutMs) {
-  Approximate::proximateLastSeenTimeoutMs = proximateLastSeenTimeoutMs;
+  this -> proximateLastSeenTimeoutMs = proximateLastSeenTimeoutMs;
+}
+
+void Approximate::setMaxRandomisedDevices(int maxRandomisedDevices) {
+  this -> maxRandomisedDevices = maxRandomisedDevices;
+}
+
+void Approximate::setShard(int shardIndex, int shardCount) {
+  this -> shardCount = max(shardCount, 1);
+  this -> shardIndex = constrain(shardIndex, 0, this -> shardCount - 1);
+}
+
+bool Approximate::isInShard(uint64_t macAddressKey) {
+  return(Device::getShardIndex(macAddressKey, shardCount) == shardIndex);
+}
+
+#if APPROXIMATE_REPORTER_ENABLED
+void Approximate::setReporter(Reporter *reporter) {
+  this -> reporter = reporter;
+  if(reporter) reporter -> setClock(clock);
+}
+#endif
+
+#if APPROXIMATE_OCCUPANCY_ENABLED
+bool Approximate::addOccupancyCounter(OccupancyCounter *occupancyCounter) {
+  bool success = false;
+
+  if(occupancyCounter && occupancyCounterList.Count() < maxOccupancyCounters) {
+    occupancyCounterList.Add(occupancyCounter);
+    success = true;
+  }
+
+  return(success);
+}
+
+void Approximate::removeOccupancyCounter(OccupancyCounter *occupancyCounter) {
+  for(int n = occupancyCounterList.Count() - 1; n >= 0; --n) {
+    if(occupancyCounterList[n] == occupancyCounter) occupancyCounterList.Remove(n);
+  }
+}
+#endif
+
+#if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+void Approximate::setTrafficCounter(TrafficCounter *trafficCounter) {
+  this -> trafficCounter = trafficCounter;
+}
+#endif
+
+#if APPROXIMATE_ALLOWLIST_ENABLED
+void Approximate::setAllowlist(Allowlist *allowlist) {
+  this -> allowlist = allowlist;
+}
+#endif
+
+void Approximate::setClock(Clock *clock) {
+  this -> clock = clock ? clock : &localClock;
+  #if APPROXIMATE_REPORTER_ENABLED
+    if(reporter) reporter -> setClock(this -> clock);
+  #endif
+}
+
+Clock *Approximate::getClock() {
+  return(clock);
 }
 
 void Approximate::setChannelStateHandler(ChannelStateHandler channelStateHandler){
-  Approximate::channelStateHandler = channelStateHandler;
+  this -> channelStateHandler = channelStateHandler;
+}
+
+void Approximate::setNearestDeviceHandler(DeviceHandler nearestDeviceHandler) {
+  this -> nearestDeviceHandler = nearestDeviceHandler;
+}
+
+void Approximate::setZoneChangeHandler(ZoneChangeHandler zoneChangeHandler, int hysteresisDb) {
+  this -> zoneChangeHandler = zoneChangeHandler;
+  this -> zoneHysteresisDb = max(hysteresisDb, 0);
+}
+
+void Approximate::onPacketEvent(void *context, wifi_promiscuous_pkt_t *pkt, uint16_t len, int type) {
+  ((Approximate *) context) -> parsePacket(pkt, len, type);
+}
+
+void Approximate::onChannelEvent(void *context, wifi_csi_info_t *info) {
+  ((Approximate *) context) -> parseChannelStateInformation(info);
 }
 
 void Approximate::parsePacket(wifi_promiscuous_pkt_t *pkt, uint16_t len, int type) {
+  observedPacketCount++;
+  uint64_t receivedAtMs = clock -> getTimeMs();
+
   switch (type) {
     case PKT_MGMT: parseMgmtPacket(pkt); break;
     case PKT_CTRL: parseCtrlPacket(pkt); break;
-    case PKT_DATA: parseDataPacket(pkt, len); break;
+    case PKT_DATA: {
+      Packet packet;
+      if(wifi_promiscuous_pkt_to_Packet(pkt, len, &packet)) {
+        packet.receivedAtMs = receivedAtMs;
+        parseDataPacket(&packet);
+      }
+      break;
+    }
     case PKT_MISC: parseMiscPacket(pkt); break;
   }
 }
 
+void Approximate::parseFrame(const uint8_t *frame, uint16_t len, int rssi, int channel, uint64_t receivedAtMs) {
+  observedPacketCount++;
+
+  //only data frames are of interest - and only if long enough to hold the header:
+  if(frame && len >= WIFI_DATA_HDR_LEN && WIFI_FCTL_TYPE(((wifi_data_hdr *) frame) -> fctl) == PKT_DATA) {
+    Packet packet;
+    if(ieee80211_to_Packet(frame, len, &packet)) {
+      packet.rssi = rssi;
+      packet.channel = channel;
+      packet.receivedAtMs = receivedAtMs;
+      parseDataPacket(&packet);
+    }
+  }
+}
+
 void Approximate::parseCtrlPacket(wifi_promiscuous_pkt_t *pkt) {
 }
 
 void Approximate::parseMgmtPacket(wifi_promiscuous_pkt_t *pkt) {
 }
 
-void Approximate::parseDataPacket(wifi_promiscuous_pkt_t *pkt, uint16_t payloadLength) {
-  Device *device = new Device();
-  if(Approximate::wifi_promiscuous_pkt_to_Device(pkt, payloadLength, device)) {
-    if(device -> isIndividual() && !device -> matches(ownMacAddress)) {
-      if(proximateDeviceHandler && device -> getRSSI() < 0 && device -> getRSSI() > proximateRSSIThreshold) {
-        onProximateDevice(device);
+void Approximate::parseDataPacket(Packet *packet) {
+  //null and QoS null frames carry no data - they are heartbeats, which keep a device present but are not activity:
+  bool heartbeat = isNullDataPacket(packet);
+
+  DeviceState frameDeviceState = {};
+  Device frameDevice(&bssidTable, &frameDeviceState);
+  Device *device = &frameDevice;
+  if(Packet_to_Device(packet, localBSSID, device) && !isRetransmission(packet, device)) {
+    if(device -> isIndividual() && !device -> matches(ownMacAddress) && isInShard(device -> getMacAddressKey())) {
+      #if APPROXIMATE_ALLOWLIST_ENABLED
+        if(allowlist) device -> setKnown(allowlist -> contains(device -> getMacAddressKey()));
+      #endif
+
+      //the RSSI is only the device's own for the frames it sent - not those the access point sent to it:
+      bool uplink = isUplink(packet, device);
+      if(uplink && device -> getRSSI() < 0) {
+        #if APPROXIMATE_REPORTER_ENABLED
+          if(reporter) reporter -> report(device, packet -> receivedAtMs);
+        #endif
+
+        //an idle device is still present - so counted, though it sends only heartbeats:
+        #if APPROXIMATE_OCCUPANCY_ENABLED
+          addToOccupancyCounters(device -> getMacAddressKey(), device -> getRSSI(), device -> getChannel(), packet -> receivedAtMs);
+        #endif
       }
 
-      if(activeDeviceHandler && (activeDeviceFilterList.IsEmpty() || applyDeviceFilters(device))) {
+      #if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+        if(trafficCounter && !heartbeat) {
+          if(device -> isUploading()) trafficCounter -> add(device -> getMacAddressKey(), TrafficCounter::UPLOAD, device -> getUploadSizeBytes());
+          else trafficCounter -> add(device -> getMacAddressKey(), TrafficCounter::DOWNLOAD, device -> getDownloadSizeBytes());
+        }
+      #endif
+
+      if(proximateDeviceHandler) {
+        if(!uplink) {
+          if(!heartbeat) onProximateDeviceActivity(device);
+        }
+        else if(device -> getRSSI() < 0 && device -> getRSSI() > proximateRSSIThreshold) onProximateDevice(device, packet -> receivedAtMs, heartbeat);
+      }
+
+      if(activeDeviceHandler && !heartbeat && (activeDeviceFilterList.IsEmpty() || applyDeviceFilters(device))) {
         DeviceEvent event = device -> isUploading() ? Approximate::SEND : Approximate::RECEIVE;
         activeDeviceHandler(device, event); 
       }
     }
   }
-  delete(device);
+}
+
+#if APPROXIMATE_OCCUPANCY_ENABLED
+void Approximate::addToOccupancyCounters(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs) {
+  for(int n = 0; n < occupancyCounterList.Count(); ++n) {
+    occupancyCounterList[n] -> add(macAddressKey, rssi, channel, timeMs);
+  }
+}
+#endif
+
+bool Approximate::isNullDataPacket(Packet *packet) {
+  //null and QoS null frames - sent by idle devices, mostly to signal power management:
+  return((packet -> subtype & ~WIFI_DATA_SUBTYPE_QOS) == WIFI_DATA_SUBTYPE_NULL);
 }
 
 void Approximate::parseMiscPacket(wifi_promiscuous_pkt_t *pkt) {
 }
 
 void Approximate::parseChannelStateInformation(wifi_csi_info_t *info) {
-  #if defined(ESP32)
+  #if APPROXIMATE_CSI_ENABLED
     if(channelStateHandler) {
-      Channel *channel = new Channel();
-      if(wifi_csi_info_to_Channel(info, channel)) {
+      Channel channel;
+      if(wifi_csi_info_to_Channel(info, &channel)) {
         //TODO: apply filtering
-        channelStateHandler(channel);
+        channelStateHandler(&channel);
       }
-      delete channel;
     }
   #endif
 }
 
-void Approximate::onProximateDevice(Device *d) {
+void Approximate::onProximateDevice(Device *d, uint64_t receivedAtMs, bool heartbeat) {
   if(d) {
     eth_addr macAddress;
     d -> getMacAddress(macAddress);
 
-    Device *proximateDevice = Approximate::getProximateDevice(macAddress);
+    Device *proximateDevice = getProximateDevice(macAddress);
+
+    if(!proximateDevice && d -> isLocal()) {
+      //a rotated address - continue as the same device:
+      proximateDevice = getRotatedDevice(d);
+      if(proximateDevice) {
+        proximateDevice -> setMacAddress(macAddress);
+        proximateDevice -> continueSequence(d);
+      }
+    }
 
     if(proximateDevice) {
-      proximateDevice->update(d);
+      if(heartbeat) {
+        //only the RSSI and time - a heartbeat carries no data flow:
+        proximateDevice -> setRSSI(d -> getRSSI());
+        proximateDevice -> setLastSeenAtMs(receivedAtMs);
+      }
+      else proximateDevice->update(d);
+      onProximateDeviceUpdate(proximateDevice, receivedAtMs);
 
-      if(activeDeviceHandler) {
+      if(activeDeviceHandler && !heartbeat) {
         DeviceEvent event = proximateDevice -> isUploading() ? Approximate::SEND : Approximate::RECEIVE;
         activeDeviceHandler(proximateDevice, event);
       }
     }
     else {
-      proximateDevice = new Device(d);
-      proximateDeviceList.Add(proximateDevice);
-      proximateDeviceHandler(proximateDevice, Approximate::ARRIVE);
+      if(d -> isLocal()) evictRandomisedDevices(maxRandomisedDevices - 1);
+
+      proximateDevice = proximateDevicePool.allocate();
+      if(proximateDevice) {
+        *proximateDevice = Device(&bssidTable, &proximateDeviceStates[proximateDevicePool.indexOf(proximateDevice)]);
+        proximateDevice -> copy(d);
+        proximateDeviceList.Add(proximateDevice);
+        proximateDeviceHandler(proximateDevice, Approximate::ARRIVE);
+        onProximateDeviceUpdate(proximateDevice, receivedAtMs);
+      }
+      else {
+        //the table is full:
+        droppedArrivalCount++;
+      }
     }
   }
 }
 
+void Approximate::onProximateDeviceActivity(Device *d) {
+  //a frame the access point sent to a device - the RSSI is the access point's, so it only keeps a proximate device present:
+  eth_addr macAddress;
+  d -> getMacAddress(macAddress);
+
+  Device *proximateDevice = getProximateDevice(macAddress);
+  if(proximateDevice) {
+    proximateDevice -> updateActivity(d);
+
+    if(activeDeviceHandler) {
+      DeviceEvent event = proximateDevice -> isUploading() ? Approximate::SEND : Approximate::RECEIVE;
+      activeDeviceHandler(proximateDevice, event);
+    }
+  }
+}
+
+Device *Approximate::getRotatedDevice(Device *d) {
+  Device *rotatedDevice = NULL;
+  int rotatedDeviceRSSIDelta = randomisedMaxRSSIDelta + 1;
+
+  //a randomised address that has fallen silent, at a similar RSSI, with continuous sequence numbers:
+  for (int n = 0; n < proximateDeviceList.Count(); n++) {
+    Device *candidate = proximateDeviceList[n];
+
+    if(candidate -> isLocal() && candidate -> getLastSeenAgeMs(d -> getLastSeenAtMs()) >= randomisedMinSilenceMs) {
+      int rssiDelta = abs(d -> getRSSI() - candidate -> getRSSI());
+
+      if(rssiDelta < rotatedDeviceRSSIDelta && candidate -> isSequenceContinuous(d)) {
+        rotatedDevice = candidate;
+        rotatedDeviceRSSIDelta = rssiDelta;
+      }
+    }
+  }
+
+  return(rotatedDevice);
+}
+
+void Approximate::evictRandomisedDevices(int maxCount) {
+  int count = 0;
+  for (int n = 0; n < proximateDeviceList.Count(); n++) {
+    if(proximateDeviceList[n] -> isLocal()) count++;
+  }
+
+  //depart the least recently seen until within the limit:
+  uint64_t now = clock -> getTimeMs();
+  for(; count > maxCount && count > 0; count--) {
+    int leastRecentlySeen = -1;
+    for (int n = 0; n < proximateDeviceList.Count(); n++) {
+      if(proximateDeviceList[n] -> isLocal()) {
+        if(leastRecentlySeen == -1 || proximateDeviceList[n] -> getLastSeenAgeMs(now) > proximateDeviceList[leastRecentlySeen] -> getLastSeenAgeMs(now)) {
+          leastRecentlySeen = n;
+        }
+      }
+    }
+
+    Device *proximateDevice = proximateDeviceList[leastRecentlySeen];
+    proximateDeviceHandler(proximateDevice, Approximate::DEPART);
+
+    proximateDeviceList.Remove(leastRecentlySeen);
+    onProximateDeviceRemove(proximateDevice);
+    proximateDevicePool.release(proximateDevice);
+  }
+}
+
 void Approximate::updateProximateDeviceList() {
-  if(packetSniffer && packetSniffer -> isRunning() && proximateLastSeenTimeoutMs > 0) {
+  if((clock -> isVirtual() || (packetSniffer && packetSniffer -> isRunning())) && proximateLastSeenTimeoutMs > 0) {
     //only update if we have the possibility of new observations
+    uint64_t now = clock -> getTimeMs();
     Device *proximateDevice = NULL;
     for (int n = 0; n < proximateDeviceList.Count(); n++) {
       proximateDevice = proximateDeviceList[n];
 
-      if((millis() - proximateDevice -> getLastSeenAtMs()) > proximateLastSeenTimeoutMs) {
+      if(proximateDevice -> getLastSeenAgeMs(now) > (uint32_t) proximateLastSeenTimeoutMs) {
         proximateDeviceHandler(proximateDevice, Approximate::DEPART);
 
         proximateDeviceList.Remove(n);
         n=0;
-        delete proximateDevice;
+        onProximateDeviceRemove(proximateDevice);
+        proximateDevicePool.release(proximateDevice);
       }
     }
   }
 }
 
+//only for frames the device sent itself - those from the access point carry its RSSI, and go to onProximateDeviceActivity():
+void Approximate::onProximateDeviceUpdate(Device *device, uint64_t timeMs) {
+  #if APPROXIMATE_RSSI_HISTORY_ENABLED
+    //by the time the frame was received - not when it was handled:
+    device -> getRSSIHistory() -> add(device -> getRSSI(), timeMs);
+  #endif
+  updateNearestDevice(device);
+  if(zoneChangeHandler) updateZone(device);
+}
+
+void Approximate::onProximateDeviceRemove(Device *device) {
+  removeNearestDevice(device);
+
+  if(zoneChangeHandler && device -> getZone() != NO_ZONE) {
+    Zone lastZone = (Zone) device -> getZone();
+    device -> setZone(NO_ZONE);
+    zoneChangeHandler(device, lastZone, NO_ZONE);
+  }
+}
+
+void Approximate::updateZone(Device *device) {
+  Zone lastZone = (Zone) device -> getZone();
+  int rssi = device -> getSmoothedRSSI();
+
+  //hysteresis - a band is only entered once the RSSI is clear of its edge, from either side:
+  Zone zone = lastZone;
+  Zone closerZone = getZone(rssi - zoneHysteresisDb);
+  Zone furtherZone = getZone(rssi + zoneHysteresisDb);
+  if(lastZone == NO_ZONE)           zone = getZone(rssi);
+  else if(closerZone > lastZone)    zone = closerZone;
+  else if(furtherZone < lastZone)   zone = furtherZone;
+
+  if(zone != lastZone) {
+    device -> setZone(zone);
+    zoneChangeHandler(device, lastZone, zone);
+  }
+}
+
+Approximate::Zone Approximate::getZone(int rssi) {
+  Zone zone = NO_ZONE;
+
+  if(rssi != APPROXIMATE_UNKNOWN_RSSI) {
+    if(rssi > APPROXIMATE_INTIMATE_RSSI)        zone = INTIMATE_ZONE;
+    else if(rssi > APPROXIMATE_PERSONAL_RSSI)   zone = PERSONAL_ZONE;
+    else if(rssi > APPROXIMATE_SOCIAL_RSSI)     zone = SOCIAL_ZONE;
+    else if(rssi > APPROXIMATE_PUBLIC_RSSI)     zone = PUBLIC_ZONE;
+  }
+
+  return(zone);
+}
+
+void Approximate::updateNearestDevice(Device *device) {
+  int index = -1;
+  for (int n = 0; n < nearestDeviceList.Count() && index < 0; n++) {
+    if(nearestDeviceList[n] == device) index = n;
+  }
+
+  if(index < 0 && nearestDeviceList.Add(device)) index = nearestDeviceList.Count() - 1;
+
+  if(index >= 0) {
+    //an RSSI changes by a little at a time, so the device moves only a place or two:
+    int rssi = device -> getSmoothedRSSI();
+    for(; index > 0 && nearestDeviceList[index - 1] -> getSmoothedRSSI() < rssi; index--) {
+      nearestDeviceList[index] = nearestDeviceList[index - 1];
+      nearestDeviceList[index - 1] = device;
+    }
+    for(; index < nearestDeviceList.Count() - 1 && nearestDeviceList[index + 1] -> getSmoothedRSSI() > rssi; index++) {
+      nearestDeviceList[index] = nearestDeviceList[index + 1];
+      nearestDeviceList[index + 1] = device;
+    }
+
+    onNearestDeviceChange();
+  }
+}
+
+void Approximate::removeNearestDevice(Device *device) {
+  for (int n = 0; n < nearestDeviceList.Count(); n++) {
+    if(nearestDeviceList[n] == device) nearestDeviceList.Remove(n);
+  }
+
+  if(nearestDevice == device) nearestDevice = NULL;
+  onNearestDeviceChange();
+}
+
+void Approximate::onNearestDeviceChange() {
+  Device *device = nearestDeviceList.IsEmpty() ? NULL : nearestDeviceList[0];
+
+  if(device != nearestDevice) {
+    nearestDevice = device;
+    if(nearestDeviceHandler && nearestDevice) nearestDeviceHandler(nearestDevice, Approximate::NEAREST);
+  }
+}
+
+int Approximate::getNearestDevices(Device **devices, int k) {
+  int count = 0;
+
+  if(devices) {
+    for(; count < k && count < nearestDeviceList.Count(); count++) devices[count] = nearestDeviceList[count];
+  }
+
+  return(count);
+}
+
+Device *Approximate::getNearestDevice() {
+  return(nearestDevice);
+}
+
+#if APPROXIMATE_STRING_API_ENABLED
 bool Approximate::isProximateDevice(String macAddress) {
   eth_addr macAddress_eth_addr;
   String_to_eth_addr(macAddress, macAddress_eth_addr);
 
   return(isProximateDevice(macAddress_eth_addr));
 }
+#endif
 
 bool Approximate::isProximateDevice(eth_addr &macAddress) {
-  return(Approximate::getProximateDevice(macAddress));
+  return(getProximateDevice(macAddress) != NULL);
 }
 
 Device *Approximate::getProximateDevice(eth_addr &macAddress) {
   Device *proximateDevice = NULL;
+  uint64_t macAddressKey = eth_addr_to_uint64(&macAddress);
 
   for (int n = 0; n < proximateDeviceList.Count() && !proximateDevice; n++) {
-		if(proximateDeviceList[n] -> matches(macAddress)) {
+		if(proximateDeviceList[n] -> matches(macAddressKey)) {
       proximateDevice = proximateDeviceList[n];
     }
 	}
@@ -629,11 +1308,13 @@ bool Approximate::oui_to_eth_addr(int oui, eth_addr &out) {
   return(success);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 bool Approximate::String_to_eth_addr(String &in, eth_addr &out) {
   bool success = c_str_to_eth_addr(in.c_str(), out);
 
   return(success);
 }
+#endif
 
 bool Approximate::c_str_to_eth_addr(const char *in, eth_addr &out) {
   bool success = false;
@@ -659,6 +1340,7 @@ bool Approximate::c_str_to_eth_addr(const char *in, eth_addr &out) {
   return(success);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 bool Approximate::eth_addr_to_String(eth_addr &in, String &out) {
   bool success = true;
 
@@ -668,6 +1350,7 @@ bool Approximate::eth_addr_to_String(eth_addr &in, String &out) {
 
   return(success);
 }
+#endif
 
 bool Approximate::eth_addr_to_c_str(eth_addr &in, char *out) {
   bool success = true;
@@ -691,34 +1374,76 @@ bool Approximate::eth_addr_to_c_str(eth_addr &in, char *out) {
 //   return(success);
 // }
 
-bool Approximate::wifi_promiscuous_pkt_to_Device(wifi_promiscuous_pkt_t *pkt, uint16_t payloadLengthBytes, Device *device) {
+bool Approximate::wifi_promiscuous_pkt_to_Packet(wifi_promiscuous_pkt_t *wifi_pkt, uint16_t payloadLengthBytes, Packet *packet) {
   bool success = false;
 
-  Packet *packet = new Packet();
-  if(wifi_promiscuous_pkt_to_Packet(pkt, payloadLengthBytes, packet)) {
-      if(Approximate::Packet_to_Device(packet, localBSSID, device)) {
-        success = true;
-      }
+  if(wifi_pkt && ieee80211_to_Packet(wifi_pkt -> payload, payloadLengthBytes, packet)) {
+    packet -> rssi = wifi_pkt -> rx_ctrl.rssi;
+    packet -> channel = wifi_pkt -> rx_ctrl.channel;
+
+    success = true;
   }
-  delete(packet);
-  
+
   return(success);
 }
 
-bool Approximate::wifi_promiscuous_pkt_to_Packet(wifi_promiscuous_pkt_t *wifi_pkt, uint16_t payloadLengthBytes, Packet *packet) {
+bool Approximate::ieee80211_to_Packet(const uint8_t *frame, uint16_t frameLengthBytes, Packet *packet) {
   bool success = false;
 
-  if(wifi_pkt && packet) {
-    wifi_mgmt_hdr* header = (wifi_mgmt_hdr*)wifi_pkt -> payload;
-    MacAddr_to_eth_addr(&header -> sa, packet -> src);
-    MacAddr_to_eth_addr(&header -> da, packet -> dst);
-    MacAddr_to_eth_addr(&header -> bssid, packet -> bssid);
+  //no field is read beyond the length of the frame:
+  if(frame && packet && frameLengthBytes >= WIFI_DATA_HDR_LEN) {
+    wifi_data_hdr* header = (wifi_data_hdr*) frame;
+    uint16_t fctl = header -> fctl;
+
+    uint16_t headerLengthBytes = WIFI_DATA_HDR_LEN;
+    bool wds = (fctl & (WIFI_FCTL_TODS | WIFI_FCTL_FROMDS)) == (WIFI_FCTL_TODS | WIFI_FCTL_FROMDS);
+    if(wds) headerLengthBytes += WIFI_DATA_HDR_ADDR4_LEN;
+    if(WIFI_FCTL_SUBTYPE(fctl) & WIFI_DATA_SUBTYPE_QOS) {
+      headerLengthBytes += WIFI_DATA_HDR_QOS_LEN;
+      if(fctl & WIFI_FCTL_ORDER) headerLengthBytes += WIFI_DATA_HDR_HT_LEN;
+    }
 
-    packet -> rssi = wifi_pkt -> rx_ctrl.rssi;
-    packet -> channel = wifi_pkt -> rx_ctrl.channel;
-    packet -> payloadLengthBytes = payloadLengthBytes;
+    if(headerLengthBytes <= frameLengthBytes) {
+      MacAddr_to_eth_addr(&header -> addr1, packet -> receiver);
+      MacAddr_to_eth_addr(&header -> addr2, packet -> transmitter);
+      packet -> headerLengthBytes = headerLengthBytes;
+
+      switch(fctl & (WIFI_FCTL_TODS | WIFI_FCTL_FROMDS)) {
+        case 0:
+          packet -> distribution = Packet::DIRECT;
+          MacAddr_to_eth_addr(&header -> addr1, packet -> dst);
+          MacAddr_to_eth_addr(&header -> addr2, packet -> src);
+          MacAddr_to_eth_addr(&header -> addr3, packet -> bssid);
+          break;
+        case WIFI_FCTL_TODS:
+          packet -> distribution = Packet::TO_DS;
+          MacAddr_to_eth_addr(&header -> addr1, packet -> bssid);
+          MacAddr_to_eth_addr(&header -> addr2, packet -> src);
+          MacAddr_to_eth_addr(&header -> addr3, packet -> dst);
+          break;
+        case WIFI_FCTL_FROMDS:
+          packet -> distribution = Packet::FROM_DS;
+          MacAddr_to_eth_addr(&header -> addr1, packet -> dst);
+          MacAddr_to_eth_addr(&header -> addr2, packet -> bssid);
+          MacAddr_to_eth_addr(&header -> addr3, packet -> src);
+          break;
+        default:
+          //WDS/mesh - the frame is relayed between access points on behalf of src and dst:
+          packet -> distribution = Packet::WDS;
+          MacAddr_to_eth_addr(&header -> addr2, packet -> bssid);
+          MacAddr_to_eth_addr(&header -> addr3, packet -> dst);
+          MacAddr_to_eth_addr(&header -> addr4, packet -> src);
+          break;
+      }
 
-    success = true;
+      packet -> subtype = WIFI_FCTL_SUBTYPE(fctl);
+      packet -> sequenceControl = header -> seqctl;
+      packet -> retry = fctl & WIFI_FCTL_RETRY;
+
+      packet -> payloadLengthBytes = frameLengthBytes - headerLengthBytes;
+
+      success = true;
+    }
   }
 
   return(success);
@@ -728,16 +1453,43 @@ bool Approximate::Packet_to_Device(Packet *packet, eth_addr &bssid, Device *devi
   bool success = false;
 
   if(packet && device) {
-    if(eth_addr_cmp(&(packet -> src), &bssid)) {
-      //packet sent to this device - RSSI only informative for messages from device
-      device -> init(packet -> dst, bssid, packet -> channel, packet -> rssi, millis(), packet -> payloadLengthBytes);
-      ArpTable::lookupIPAddress(device);
-      success = true;
+    eth_addr *macAddress = NULL;
+    int rssi = packet -> rssi;
+    int dataFlowBytes = packet -> payloadLengthBytes;  //uploading is negative, downloading positive
+
+    switch(packet -> distribution) {
+      case Packet::TO_DS:
+      case Packet::DIRECT:
+        //packet sent by this device
+        if(eth_addr_cmp(&(packet -> bssid), &bssid)) {
+          macAddress = &(packet -> src);
+          dataFlowBytes *= -1;
+        }
+        break;
+      case Packet::FROM_DS:
+        //packet sent to this device - RSSI only informative for messages from device
+        if(eth_addr_cmp(&(packet -> bssid), &bssid)) {
+          macAddress = &(packet -> dst);
+        }
+        break;
+      case Packet::WDS:
+        //relayed by a mesh node - RSSI is that of the node, not the device
+        rssi = APPROXIMATE_UNKNOWN_RSSI;
+        if(eth_addr_cmp(&(packet -> transmitter), &bssid)) {
+          macAddress = &(packet -> dst);
+        }
+        else if(eth_addr_cmp(&(packet -> receiver), &bssid)) {
+          macAddress = &(packet -> src);
+          dataFlowBytes *= -1;
+        }
+        break;
     }
-    else if(eth_addr_cmp(&(packet -> dst), &bssid)) {
-      //packet sent by this device
-      device -> init(packet -> src, bssid, packet -> channel, packet -> rssi, millis(), packet -> payloadLengthBytes * -1);
-      ArpTable::lookupIPAddress(device);
+
+    if(macAddress) {
+      device -> init(*macAddress, bssid, packet -> channel, rssi, packet -> receivedAtMs, dataFlowBytes);
+      #if APPROXIMATE_ARP_ENABLED
+        if(arpTable) requestIPAddress(device);
+      #endif
       success = true;
     }
   }
@@ -745,10 +1497,84 @@ bool Approximate::Packet_to_Device(Packet *packet, eth_addr &bssid, Device *devi
   return(success);
 }
 
+#if APPROXIMATE_ARP_ENABLED
+void Approximate::requestIPAddress(Device *device) {
+  //from the WiFi task - so the ArpTable is never called here:
+  eth_addr macAddress;
+  device -> getMacAddress(macAddress);
+
+  Device *proximateDevice = getProximateDevice(macAddress);
+  if(proximateDevice) {
+    ip4_addr_t ipAddress;
+    proximateDevice -> getIPAddress(ipAddress);
+
+    if(ipAddress.addr != IPADDR_ANY) device -> setIPAddress(ipAddress);
+    else {
+      //once a second for a run of frames from the same device - the newest is dropped if the queue is full:
+      uint64_t macAddressKey = device -> getMacAddressKey();
+      uint32_t lastSeenAtMs = device -> getLastSeenAtMs();
+      if(macAddressKey != lastIPAddressRequestKey || (lastSeenAtMs - lastIPAddressRequestAtMs) >= 1000) {
+        uint32_t head = ipAddressRequestHead;
+        if(head - __atomic_load_n(&ipAddressRequestTail, __ATOMIC_ACQUIRE) < (uint32_t) ipAddressRequestQueueLength) {
+          ipAddressRequests[head & (ipAddressRequestQueueLength - 1)] = macAddressKey;
+          __atomic_store_n(&ipAddressRequestHead, head + 1, __ATOMIC_RELEASE);
+
+          lastIPAddressRequestKey = macAddressKey;
+          lastIPAddressRequestAtMs = lastSeenAtMs;
+        }
+      }
+    }
+  }
+}
+
+void Approximate::resolveIPAddresses() {
+  uint32_t tail = ipAddressRequestTail;
+  uint32_t head = __atomic_load_n(&ipAddressRequestHead, __ATOMIC_ACQUIRE);
+
+  for(; tail != head; ++tail) {
+    eth_addr macAddress;
+    uint64_to_eth_addr(ipAddressRequests[tail & (ipAddressRequestQueueLength - 1)], &macAddress);
+
+    //the address if it has been learnt, otherwise the device is queued to be probed for:
+    Device *proximateDevice = getProximateDevice(macAddress);
+    if(proximateDevice && !proximateDevice -> hasIPAddress()) {
+      if(!arpTable -> lookupIPAddress(proximateDevice)) arpTable -> requestIPAddress(proximateDevice);
+    }
+  }
+  __atomic_store_n(&ipAddressRequestTail, tail, __ATOMIC_RELEASE);
+}
+#endif
+
+bool Approximate::isUplink(Packet *packet, Device *device) {
+  //sent by the device itself:
+  return(device -> matches(packet -> transmitter));
+}
+
+bool Approximate::isRetransmission(Packet *packet, Device *device) {
+  bool result = false;
+
+  //sequence state is kept for the devices in the proximate device list:
+  eth_addr macAddress;
+  device -> getMacAddress(macAddress);
+
+  bool uplink = isUplink(packet, device);
+
+  Device *proximateDevice = getProximateDevice(macAddress);
+  if(proximateDevice) {
+    result = !proximateDevice -> updateSequence(packet -> sequenceControl, packet -> retry, uplink);
+  }
+  else {
+    //record on the new device - used to link rotated addresses:
+    device -> updateSequence(packet -> sequenceControl, packet -> retry, uplink);
+  }
+
+  return(result);
+}
+
 bool Approximate::wifi_csi_info_to_Channel(wifi_csi_info_t *info, Channel *channel) {
   bool success = false;
 
-  #if defined(ESP32)
+  #if APPROXIMATE_CSI_ENABLED
     if(info->len >= 128) {
       eth_addr bssid;
       uint8_t_to_eth_addr(info -> mac, bssid);
@@ -10,17 +10,38 @@
 #define Approximate_h
 
 #include <Arduino.h>
+#include "Approximate/Config.h"
 #include "Approximate/eth_addr.h"
 #include "Approximate/wifi_pkt.h"
 
 #include "Approximate/PacketSniffer.h"
 #include "Approximate/Packet.h"
+#if APPROXIMATE_REPORTER_ENABLED
+  #include "Approximate/Reporter.h"
+#endif
+#if APPROXIMATE_COLLECTOR_ENABLED
+  #include "Approximate/Collector.h"
+#endif
+#if APPROXIMATE_ALLOWLIST_ENABLED
+  #include "Approximate/Allowlist.h"
+#endif
+#if APPROXIMATE_OCCUPANCY_ENABLED
+  #include "Approximate/OccupancyCounter.h"
+#endif
+#if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+  #include "Approximate/TrafficCounter.h"
+#endif
+#if APPROXIMATE_TRAFFIC_GENERATOR_ENABLED
+  #include "Approximate/TrafficGenerator.h"
+#endif
 #include "Approximate/ArpTable.h"
 #include "Approximate/Channel.h"
+#include "Approximate/CaptureReader.h"
+#include "Approximate/Clock.h"
+#include "Approximate/Continuation.h"
 #include "Approximate/Device.h"
 #include "Approximate/Filter.h"
-
-#include <ListLib.h>              //https://github.com/luisllamasbinaburo/Arduino-List
+#include "Approximate/FixedList.h"
 
 #define APPROXIMATE_INTIMATE_RSSI -20
 #define APPROXIMATE_PERSONAL_RSSI -40
@@ -41,85 +62,255 @@ class Approximate {
       DEPART,
       SEND,
       RECEIVE,
-      INACTIVE
+      INACTIVE,
+      NEAREST
     } DeviceEvent;
 
+    //the bands of APPROXIMATE_*_RSSI, furthest first:
+    typedef enum {
+      NO_ZONE,
+      PUBLIC_ZONE,
+      SOCIAL_ZONE,
+      PERSONAL_ZONE,
+      INTIMATE_ZONE
+    } Zone;
+
+    typedef struct {
+      int channel;
+      uint8_t bssid[6];
+      uint32_t localIP;
+      uint32_t gatewayIP;
+      uint32_t subnetMask;
+      uint32_t dnsIP;
+      uint32_t leaseAgeMs;      //age of the DHCP lease when the cache was read - add any time spent asleep before restoring it
+    } ConnectionCache;
+
+    static const int reconnectLatencyBinCount = 8;
+
     typedef void (*DeviceHandler)(Device *device, DeviceEvent event);
     typedef void (*ChannelStateHandler)(Channel *channel);
+    typedef void (*ZoneChangeHandler)(Device *device, Zone lastZone, Zone zone);
 
+    #if APPROXIMATE_STRING_API_ENABLED
     static String toString(DeviceEvent e) {
       switch (e) {
         case Approximate::SEND:       return("SEND");
         case Approximate::RECEIVE:    return("RECEIVE");
         case Approximate::ARRIVE:     return("ARRIVE");
         case Approximate::DEPART:     return("DEPART");
+        case Approximate::NEAREST:    return("NEAREST");
         default:                      return("INACTIVE");
       }
     }
 
-  private:
-    static bool running;
-
-    static PacketSniffer *packetSniffer;
-    static ArpTable *arpTable;
+    static String toString(Zone z) {
+      switch (z) {
+        case Approximate::PUBLIC_ZONE:    return("PUBLIC");
+        case Approximate::SOCIAL_ZONE:    return("SOCIAL");
+        case Approximate::PERSONAL_ZONE:  return("PERSONAL");
+        case Approximate::INTIMATE_ZONE:  return("INTIMATE");
+        default:                          return("NONE");
+      }
+    }
+    #endif
 
-    char *ssid = new char[32];
-    char *password = new char[64];
+  private:
+    //all pipeline state is per instance - the radio reaches it through the context handed to the trampolines:
+    bool running = false;
+
+    PacketSniffer *packetSniffer;
+    #if APPROXIMATE_ARP_ENABLED
+      ArpTable localArpTable;
+
+      //proximate devices still waiting on an IP address - posted from the WiFi task, passed on to the ArpTable from loop():
+      static const int ipAddressRequestQueueLength = 32;
+      uint64_t ipAddressRequests[ipAddressRequestQueueLength];
+      uint32_t ipAddressRequestHead = 0;
+      uint32_t ipAddressRequestTail = 0;
+      uint64_t lastIPAddressRequestKey = 0;
+      uint32_t lastIPAddressRequestAtMs = 0;
+      void requestIPAddress(Device *device);
+      void resolveIPAddresses();
+    #endif
+    ArpTable *arpTable = NULL;
+
+    //device times come from here - frames are stamped once, as they arrive:
+    Clock localClock;
+    Clock *clock = &localClock;
+
+    char ssid[33] = "";
+    char password[65] = "";
 
     wl_status_t currentWifiStatus = WL_IDLE_STATUS;
     bool init(int channel, uint8_t *bssid, bool ipAddressResolution, bool csiEnabled);
     void onWifiStatusChange(wl_status_t oldStatus, wl_status_t newStatus);
 
-    //TODO: template this?
+    //fast reconnect - skip the scan, reinitialisation and DHCP using the last good connection:
+    bool fastReconnect = false;
+    bool wifiInitialised = false;
+    ConnectionCache connectionCache = {0, {0,0,0,0,0,0}, 0, 0, 0, 0, 0};
+    void updateConnectionCache();
+
+    //a cached lease is only reused until it reaches maxLeaseAgeMs or a connection using it fails, then DHCP is used again:
+    unsigned long maxLeaseAgeMs = 3600000;
+    unsigned long leaseObtainedAtMs = 0;
+    bool usingCachedLease = false;
+    bool isCachedLeaseReusable();
+    void onConnectFailed();
+
+    //time from connectWiFi() to WL_CONNECTED, binned by powers of two from 128ms:
+    unsigned long connectWiFiStartedAtMs = 0;
+    unsigned long lastReconnectLatencyMs = 0;
+    int reconnectLatencyHistogram[reconnectLatencyBinCount] = {0};
+    void onReconnected();
+
+    //duty cycle - outbound work waits for a batched uplink window between sniff windows:
+    unsigned long sniffWindowMs = 0;
+    unsigned long uplinkWindowMs = 0;
+    static const unsigned long uplinkConnectTimeoutMs = 10000;
+    bool uplinkRequested = false;
+    bool uplinkWindowOpen = false;
+    unsigned long windowStartedAtMs = 0;
+    unsigned long uplinkConnectedAtMs = 0;
+    bool isDutyCycled();
+    void updateDutyCycle();
+
+    unsigned long dutyCycleUpdatedAtMs = 0;
+    unsigned long sniffingMs = 0;
+    unsigned long blindMs = 0;
+    unsigned long observedPacketCount = 0;
+
+    //health - the heap low-water mark, fragmentation and packet rate, sampled once a second of clock time:
+    static const int healthSampleIntervalMs = 1000;
+    uint64_t healthSampledAtMs = 0;
+    unsigned long healthSampledPacketCount = 0;
+    uint32_t minFreeHeapBytes = 0;
+    uint8_t maxHeapFragmentation = 0;
+    unsigned long packetRate = 0;
+    unsigned long droppedArrivalCount = 0;
+    void updateHealth();
+
     typedef void (*voidFnPtr)();
     typedef void (*voidFnPtrWithStringPayload)(String);
     typedef void (*voidFnPtrWithBoolPayload)(bool);
-    typedef void (*voidFnPtrWithFnPtrPayload)(voidFnPtr);    
-    voidFnPtr onceWifiStatusFnPtr = NULL;
-    voidFnPtrWithStringPayload onceWifiStatusWithStringPayloadFnPtr = NULL;
-    voidFnPtrWithBoolPayload onceWifiStatusWithBoolPayloadFnPtr = NULL;
-    voidFnPtrWithFnPtrPayload onceWifiStatusWithFnPtrPayloadFnPtr = NULL;
-    String onceWifiStatusStringPayload;
-    bool onceWifiStatusBoolPayload;
-    voidFnPtr onceWifiStatusFnPtrPayload;
-    wl_status_t triggerWifiStatus = WL_IDLE_STATUS;
-
-    static void parsePacket(wifi_promiscuous_pkt_t *pkt, uint16_t len, int type);
-    static void parseMgmtPacket(wifi_promiscuous_pkt_t *pkt);
-    static void parseCtrlPacket(wifi_promiscuous_pkt_t *pkt);
-    static void parseDataPacket(wifi_promiscuous_pkt_t *pkt, uint16_t payloadLength);
-    static void parseMiscPacket(wifi_promiscuous_pkt_t *pkt);
-
-    static void parseChannelStateInformation(wifi_csi_info_t *info);
-
-    static DeviceHandler activeDeviceHandler;
-    static DeviceHandler proximateDeviceHandler;
-    static ChannelStateHandler channelStateHandler;
+    typedef void (*voidFnPtrWithFnPtrPayload)(voidFnPtr);
+
+    //pending onceWifiStatus() callbacks - run in the order queued when the status is reached:
+    static const int maxContinuations = APPROXIMATE_MAX_CONTINUATIONS;
+    Continuation continuations[maxContinuations];
+    uint32_t continuationSequence = 0;
+    bool runningContinuations = false;
+    Continuation *queueContinuation(wl_status_t status);
+    void runContinuations(wl_status_t status);
+
+    template<typename Payload>
+    bool queueOnceWifiStatus(wl_status_t status, void (*callBackFnPtr)(Payload), const Payload &payload);
+
+    typedef struct {
+      Approximate *approximate;
+      voidFnPtr thenFnPtr;
+    } BeginContext;
+    static void onBeginConnected(BeginContext beginContext);
+
+    static void onPacketEvent(void *context, wifi_promiscuous_pkt_t *pkt, uint16_t len, int type);
+    static void onChannelEvent(void *context, wifi_csi_info_t *info);
+
+    void parseMgmtPacket(wifi_promiscuous_pkt_t *pkt);
+    void parseCtrlPacket(wifi_promiscuous_pkt_t *pkt);
+    void parseDataPacket(Packet *packet);
+    static bool isNullDataPacket(Packet *packet);
+    void parseMiscPacket(wifi_promiscuous_pkt_t *pkt);
+    #if APPROXIMATE_OCCUPANCY_ENABLED
+      void addToOccupancyCounters(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs);
+    #endif
+
+    DeviceHandler activeDeviceHandler = NULL;
+    DeviceHandler proximateDeviceHandler = NULL;
+    ChannelStateHandler channelStateHandler = NULL;
 
     void updateProximateDeviceList();
 
-    static eth_addr ownMacAddress;
-
-    static eth_addr localBSSID;
-    static List<Filter *> activeDeviceFilterList;
-    static bool applyDeviceFilters(Device *device);
-
-    static List<Device *> proximateDeviceList;
-    static Device *getProximateDevice(eth_addr &macAddress);
-    static void onProximateDevice(Device *proximateDevice);
-    static int proximateRSSIThreshold;
-    static int proximateLastSeenTimeoutMs;
+    eth_addr ownMacAddress = {{0,0,0,0,0,0}};
+
+    eth_addr localBSSID = {{0,0,0,0,0,0}};
+    FixedPool<Filter, APPROXIMATE_MAX_FILTERS> activeDeviceFilterPool;
+    FixedList<Filter *, APPROXIMATE_MAX_FILTERS> activeDeviceFilterList;
+    bool applyDeviceFilters(Device *device);
+
+    //each device in the pool holds its record - the rest of its state is in a side table, at the same index:
+    BssidTable bssidTable;
+    FixedPool<Device, APPROXIMATE_MAX_DEVICES> proximateDevicePool;
+    DeviceState proximateDeviceStates[APPROXIMATE_MAX_DEVICES];
+    FixedList<Device *, APPROXIMATE_MAX_DEVICES> proximateDeviceList;
+    Device *getProximateDevice(eth_addr &macAddress);
+    void onProximateDevice(Device *proximateDevice, uint64_t receivedAtMs, bool heartbeat = false);
+    void onProximateDeviceActivity(Device *device);
+    int proximateRSSIThreshold = APPROXIMATE_PERSONAL_RSSI;
+
+    //the proximate devices again, strongest smoothed RSSI first - kept in order as each is updated:
+    FixedList<Device *, APPROXIMATE_MAX_DEVICES> nearestDeviceList;
+    DeviceHandler nearestDeviceHandler = NULL;
+    Device *nearestDevice = NULL;
+    void updateNearestDevice(Device *device);
+    void removeNearestDevice(Device *device);
+    void onNearestDeviceChange();
+
+    //every change of a proximate device's smoothed RSSI passes through these:
+    void onProximateDeviceUpdate(Device *device, uint64_t timeMs);
+    void onProximateDeviceRemove(Device *device);
+
+    ZoneChangeHandler zoneChangeHandler = NULL;
+    int zoneHysteresisDb = 3;
+    void updateZone(Device *device);
+    static Zone getZone(int rssi);
+    int proximateLastSeenTimeoutMs = 60000;
+
+    //locally administered (randomised) addresses - rotations are linked to one device, and their number capped:
+    int maxRandomisedDevices = 32;
+    static const int randomisedMinSilenceMs = 1000;
+    static const int randomisedMaxRSSIDelta = 10;
+    Device *getRotatedDevice(Device *device);
+    void evictRandomisedDevices(int maxCount);
+
+    //sharding - an instance only tracks the devices whose address hashes to its shard:
+    int shardIndex = 0;
+    int shardCount = 1;
+    bool isInShard(uint64_t macAddressKey);
+
+    //observations of every tracked device are also sent on to a collector:
+    #if APPROXIMATE_REPORTER_ENABLED
+      Reporter *reporter = NULL;
+    #endif
+
+    //distinct devices are counted from every frame - apart from the device table, so not limited by its size:
+    #if APPROXIMATE_OCCUPANCY_ENABLED
+      static const int maxOccupancyCounters = 4;
+      FixedList<OccupancyCounter *, maxOccupancyCounters> occupancyCounterList;
+    #endif
+
+    //as are the bytes sent and received by each device:
+    #if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+      TrafficCounter *trafficCounter = NULL;
+    #endif
+
+    //each device is marked known if its address is in the allowlist:
+    #if APPROXIMATE_ALLOWLIST_ENABLED
+      Allowlist *allowlist = NULL;
+    #endif
 
     void printWiFiStatus();
 
-    static bool wifi_promiscuous_pkt_to_Device(wifi_promiscuous_pkt_t *pkt, uint16_t payloadLengthBytes, Device *device);
     static bool wifi_promiscuous_pkt_to_Packet(wifi_promiscuous_pkt_t *in, uint16_t payloadLengthBytes, Packet *out);
-    static bool Packet_to_Device(Packet *packet, eth_addr &bssid, Device *device);
+    static bool ieee80211_to_Packet(const uint8_t *in, uint16_t frameLengthBytes, Packet *out);
+    bool Packet_to_Device(Packet *packet, eth_addr &bssid, Device *device);
+    bool isUplink(Packet *packet, Device *device);
+    bool isRetransmission(Packet *packet, Device *device);
 
     static bool wifi_csi_info_to_Channel(wifi_csi_info_t *info, Channel *channel);
 
   public:
     Approximate();
+    ~Approximate();
     bool init();
     bool init(String ssid, String password, bool ipAddressResolution = false, bool csiEnabled = false);
 
@@ -129,8 +320,15 @@ class Approximate {
     void loop();
     bool isRunning();
 
+    //feed one frame through this instance - as the radio does, or from a capture:
+    void parsePacket(wifi_promiscuous_pkt_t *pkt, uint16_t len, int type);
+    void parseFrame(const uint8_t *frame, uint16_t len, int rssi, int channel, uint64_t receivedAtMs);
+    void parseChannelStateInformation(wifi_csi_info_t *info);
+
     //add one more filter
+    #if APPROXIMATE_STRING_API_ENABLED
     void addActiveDeviceFilter(String macAddress);
+    #endif
     void addActiveDeviceFilter(char *macAddress);
     void addActiveDeviceFilter(Device &device);
     void addActiveDeviceFilter(Device *device);
@@ -138,49 +336,114 @@ class Approximate {
     void addActiveDeviceFilter(int oui);
 
     //set exactly one filter
+    #if APPROXIMATE_STRING_API_ENABLED
     void setActiveDeviceFilter(String macAddress);
+    #endif
     void setActiveDeviceFilter(char *macAddress);
     void setActiveDeviceFilter(Device &device);
     void setActiveDeviceFilter(Device *device);
     void setActiveDeviceFilter(eth_addr &macAddress);
     void setActiveDeviceFilter(int oui);
 
+    #if APPROXIMATE_STRING_API_ENABLED
     void removeActiveDeviceFilter(String macAddress);
+    #endif
     void removeActiveDeviceFilter(Device &device);
     void removeActiveDeviceFilter(Device *device);
     void removeActiveDeviceFilter(eth_addr &macAddress);
     void removeActiveDeviceFilter(int oui);
     void removeAllActiveDeviceFilters();
 
+    #if APPROXIMATE_STRING_API_ENABLED
     void setLocalBSSID(String macAddress);
+    #endif
     void setLocalBSSID(eth_addr &macAddress);
 
+    #if APPROXIMATE_STRING_API_ENABLED
     bool isProximateDevice(String macAddress);
+    #endif
     bool isProximateDevice(eth_addr &macAddress);
 
     void setActiveDeviceHandler(DeviceHandler activeDeviceHandler, bool inclusive = true);
     void setProximateDeviceHandler(DeviceHandler deviceHandler, int rssiThreshold = APPROXIMATE_PERSONAL_RSSI, int lastSeenTimeoutMs = 60000);
     void setChannelStateHandler(ChannelStateHandler channelStateHandler);
-
-    static void setProximateRSSIThreshold(int proximateRSSIThreshold);
-    static void setProximateLastSeenTimeoutMs(int proximateLastSeenTimeoutMs);
-
+    void setNearestDeviceHandler(DeviceHandler nearestDeviceHandler);
+    void setZoneChangeHandler(ZoneChangeHandler zoneChangeHandler, int hysteresisDb = 3);
+
+    //the k nearest proximate devices, nearest first - returns the number written:
+    int getNearestDevices(Device **devices, int k);
+    Device *getNearestDevice();
+
+    void setProximateRSSIThreshold(int proximateRSSIThreshold);
+    void setProximateLastSeenTimeoutMs(int proximateLastSeenTimeoutMs);
+    void setMaxRandomisedDevices(int maxRandomisedDevices);
+
+    void setShard(int shardIndex, int shardCount);
+    #if APPROXIMATE_REPORTER_ENABLED
+    void setReporter(Reporter *reporter);
+    #endif
+
+    #if APPROXIMATE_OCCUPANCY_ENABLED
+    bool addOccupancyCounter(OccupancyCounter *occupancyCounter);
+    void removeOccupancyCounter(OccupancyCounter *occupancyCounter);
+    #endif
+    #if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+    void setTrafficCounter(TrafficCounter *trafficCounter);
+    #endif
+    #if APPROXIMATE_ALLOWLIST_ENABLED
+    void setAllowlist(Allowlist *allowlist);
+    #endif
+
+    void setClock(Clock *clock);
+    Clock *getClock();
+
+    #if APPROXIMATE_STRING_API_ENABLED
     wl_status_t connectWiFi(String ssid, String password);
+    #endif
     wl_status_t connectWiFi(char *ssid, char *password);
     wl_status_t connectWiFi();
     void disconnectWiFi();
 
-    void onceWifiStatus(wl_status_t status, voidFnPtr callBackFnPtr);
-    void onceWifiStatus(wl_status_t status, voidFnPtrWithStringPayload callBackFnPtr, String payload);
-    void onceWifiStatus(wl_status_t status, voidFnPtrWithBoolPayload callBackFnPtr, bool payload);
-    void onceWifiStatus(wl_status_t status, voidFnPtrWithFnPtrPayload callBackFnPtr, voidFnPtr payload);
+    void setDutyCycle(unsigned long sniffWindowMs, unsigned long uplinkWindowMs = 2000);
+    float getBlindTimeRatio();
+    unsigned long getLostObservationEstimate();
+
+    void setFastReconnect(bool fastReconnect, unsigned long maxLeaseAgeMs = 3600000);
+    bool getConnectionCache(ConnectionCache &connectionCache);
+    void setConnectionCache(ConnectionCache &connectionCache);
+
+    unsigned long getLastReconnectLatencyMs();
+    int getReconnectLatencyCount(int bin);
+    unsigned long getReconnectLatencyBinUpperMs(int bin);
+    void printReconnectLatencyHistogram();
+
+    void printSizeReport();
+
+    static uint32_t getFreeHeapBytes();
+    static uint8_t getHeapFragmentation();
+    uint32_t getMinFreeHeapBytes();
+    uint8_t getMaxHeapFragmentation();
+    unsigned long getPacketRate();
+    unsigned long getObservedPacketCount();
+    unsigned long getDroppedArrivalCount();
+    int getProximateDeviceCount();
+    void printHealthReport();
+
+    bool onceWifiStatus(wl_status_t status, voidFnPtr callBackFnPtr);
+    #if APPROXIMATE_STRING_API_ENABLED
+    bool onceWifiStatus(wl_status_t status, voidFnPtrWithStringPayload callBackFnPtr, String payload);
+    #endif
+    bool onceWifiStatus(wl_status_t status, voidFnPtrWithBoolPayload callBackFnPtr, bool payload);
+    bool onceWifiStatus(wl_status_t status, voidFnPtrWithFnPtrPayload callBackFnPtr, voidFnPtr payload);
 
     static bool MacAddr_to_eth_addr(MacAddr *in, eth_addr &out);
     static bool uint8_t_to_eth_addr(uint8_t *in, eth_addr &out);
     static bool oui_to_eth_addr(int oui, eth_addr &out);
     static bool c_str_to_eth_addr(const char *in, eth_addr &out);
+    #if APPROXIMATE_STRING_API_ENABLED
     static bool String_to_eth_addr(String &in, eth_addr &out);
     static bool eth_addr_to_String(eth_addr &in, String &out);
+    #endif
     static bool eth_addr_to_c_str(eth_addr &in, char *out);
 };
 
@@ -0,0 +1,132 @@
+/*
+    Allowlist.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Allowlist.h"
+
+#if APPROXIMATE_ALLOWLIST_ENABLED
+
+//See: Kirsch and Mitzenmacher, Less hashing, same performance: building a better Bloom filter (2006)
+
+Allowlist::Allowlist() {
+}
+
+bool Allowlist::begin(const uint8_t *blob, size_t lengthBytes) {
+    bool success = false;
+
+    end();
+    if(blob && lengthBytes >= headerLengthBytes && readLittleEndian32(blob) == magic) {
+        uint32_t bitCount = readLittleEndian32(blob + 4);
+        int hashCount = pgm_read_byte(blob + 12);
+
+        if(bitCount > 0 && hashCount > 0 && hashCount <= maxHashCount && ((bitCount + 7) / 8) <= (lengthBytes - headerLengthBytes)) {
+            this -> bits = blob + headerLengthBytes;
+            this -> bitCount = bitCount;
+            this -> itemCount = readLittleEndian32(blob + 8);
+            this -> hashCount = hashCount;
+            success = true;
+        }
+    }
+
+    return(success);
+}
+
+void Allowlist::end() {
+    bits = NULL;
+    bitCount = 0;
+    itemCount = 0;
+    hashCount = 0;
+}
+
+bool Allowlist::isLoaded() {
+    return(bits != NULL);
+}
+
+bool Allowlist::contains(uint64_t macAddressKey) {
+    bool found = isLoaded();
+
+    //each probe is h1 + (n * h2), both halves of the one hash:
+    uint64_t hash = Device::getMacAddressHash(macAddressKey);
+    uint32_t h1 = hash;
+    uint32_t h2 = (hash >> 32) | 1;
+    for(int n = 0; n < hashCount && found; ++n) {
+        uint32_t i = (h1 + (n * h2)) % bitCount;
+        found = pgm_read_byte(bits + (i >> 3)) & (1 << (i & 7));
+    }
+
+    return(found);
+}
+
+bool Allowlist::contains(eth_addr &macAddress) {
+    return(contains(eth_addr_to_uint64(&macAddress)));
+}
+
+uint32_t Allowlist::getItemCount() {
+    return(itemCount);
+}
+
+float Allowlist::getFalsePositiveRate() {
+    float falsePositiveRate = 0.0;
+
+    if(isLoaded()) {
+        falsePositiveRate = pow(1.0 - exp(-((float) hashCount * itemCount) / bitCount), hashCount);
+    }
+
+    return(falsePositiveRate);
+}
+
+size_t Allowlist::getLengthBytes(uint32_t itemCount, float falsePositiveRate) {
+    //the optimal number of bits is -n ln(p) / ln(2)^2:
+    float p = constrain(falsePositiveRate, 0.0001f, 0.5f);
+    uint32_t bitCount = (uint32_t) ceil(-((float) max(itemCount, (uint32_t) 1)) * log(p) / (M_LN2 * M_LN2));
+
+    return(headerLengthBytes + ((bitCount + 7) / 8));
+}
+
+bool Allowlist::build(uint8_t *blob, size_t lengthBytes, const uint64_t *macAddressKeys, uint32_t itemCount) {
+    bool success = false;
+
+    if(blob && lengthBytes > headerLengthBytes && (macAddressKeys || itemCount == 0)) {
+        uint32_t bitCount = (lengthBytes - headerLengthBytes) * 8;
+
+        //the optimal number of probes is (m / n) ln(2):
+        int hashCount = constrain((int) round(((float) bitCount / max(itemCount, (uint32_t) 1)) * M_LN2), 1, maxHashCount);
+
+        memset(blob, 0, lengthBytes);
+        writeLittleEndian32(blob, magic);
+        writeLittleEndian32(blob + 4, bitCount);
+        writeLittleEndian32(blob + 8, itemCount);
+        blob[12] = hashCount;
+
+        uint8_t *bits = blob + headerLengthBytes;
+        for(uint32_t k = 0; k < itemCount; ++k) {
+            uint64_t hash = Device::getMacAddressHash(macAddressKeys[k]);
+            uint32_t h1 = hash;
+            uint32_t h2 = (hash >> 32) | 1;
+            for(int n = 0; n < hashCount; ++n) {
+                uint32_t i = (h1 + (n * h2)) % bitCount;
+                bits[i >> 3] |= (1 << (i & 7));
+            }
+        }
+        success = true;
+    }
+
+    return(success);
+}
+
+uint32_t Allowlist::readLittleEndian32(const uint8_t *p) {
+    return(((uint32_t) pgm_read_byte(p)) | ((uint32_t) pgm_read_byte(p + 1) << 8) | ((uint32_t) pgm_read_byte(p + 2) << 16) | ((uint32_t) pgm_read_byte(p + 3) << 24));
+}
+
+void Allowlist::writeLittleEndian32(uint8_t *p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+    Allowlist.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Allowlist_h
+#define Allowlist_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "eth_addr.h"
+#include "Device.h"
+
+//A Bloom filter of known MAC addresses, read in place from flash - never a false negative, rarely a false positive:
+//
+//  0   magic       uint32  0x46425041 ("APBF")
+//  4   bitCount    uint32
+//  8   itemCount   uint32
+//  12  hashCount   uint8
+//  13  reserved    3 bytes
+//  16  bits        (bitCount + 7) / 8 bytes
+//
+//All values are little-endian. Bit i of the filter is bit (i % 8) of byte (i / 8).
+class Allowlist {
+    public:
+        static const uint32_t magic = 0x46425041;
+        static const int headerLengthBytes = 16;
+        static const int maxHashCount = 16;
+
+        Allowlist();
+
+        //the blob may be in PROGMEM or mapped flash - it is not copied, so must outlive the allowlist:
+        bool begin(const uint8_t *blob, size_t lengthBytes);
+        void end();
+        bool isLoaded();
+
+        bool contains(uint64_t macAddressKey);
+        bool contains(eth_addr &macAddress);
+
+        uint32_t getItemCount();
+        float getFalsePositiveRate();
+
+        //for building a blob - on a computer or at runtime - sized for the false positive rate wanted:
+        static size_t getLengthBytes(uint32_t itemCount, float falsePositiveRate = 0.01);
+        static bool build(uint8_t *blob, size_t lengthBytes, const uint64_t *macAddressKeys, uint32_t itemCount);
+
+    private:
+        const uint8_t *bits = NULL;
+        uint32_t bitCount = 0;
+        uint32_t itemCount = 0;
+        int hashCount = 0;
+
+        static uint32_t readLittleEndian32(const uint8_t *p);
+        static void writeLittleEndian32(uint8_t *p, uint32_t value);
+};
+
+#endif
@@ -8,10 +8,10 @@
 
 #include "ArpTable.h"
 
-bool ArpTable::running = false;
+#if APPROXIMATE_ARP_ENABLED
 
-ip4_addr_t ArpTable::localNetwork;
-uint32_t *ArpTable::cache = new uint32_t[256];
+netif_input_fn ArpTable::originalInput = NULL;
+ArpTable *ArpTable::hookedArpTable = NULL;
 
 #if defined(ESP8266)
     const int ArpTable::minUpdateIntervalMs = 300;  //updating more frequently is unsafe
@@ -23,36 +23,114 @@ ArpTable::ArpTable(int updateIntervalMs, bool repeatedScans) {
     updateIntervalMs = max(updateIntervalMs, minUpdateIntervalMs);
 
     this -> updateIntervalMs = updateIntervalMs;
-    this -> lastUpdateTimeMs = -updateIntervalMs;
+    this -> lastUpdateTimeMs = -updateIntervalMs;    //so the first probe is due at once
 
     this -> repeatedScans = repeatedScans;
 }
 
-ArpTable* ArpTable::getInstance(int updateIntervalMs, bool repeatedScans) {
-    static ArpTable at(updateIntervalMs, repeatedScans);
-    return &at;
-}
-
 void ArpTable::begin() {
+    if(WiFi.status() == WL_CONNECTED) {
+        setLocalNetwork();
+
+        //start from whatever lwIP has learnt already - no requests are sent:
+        for(int n=0; n<256; ++n)    find(n, false);
+    }
+
+    //discard anything learnt before - as the consumer:
+    __atomic_store_n(&learntAddressTail, __atomic_load_n(&learntAddressHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+
+    //hook the netif input so that every ARP reply or gratuitous ARP updates the cache:
+    if(netif_default && !originalInput) {
+        originalInput = netif_default -> input;
+        netif_default -> input = netifInputHook;
+        hookedArpTable = this;
+    }
+
     running = true;
 }
 
 void ArpTable::end() {
+    if(netif_default && originalInput && hookedArpTable == this) {
+        netif_default -> input = originalInput;
+        originalInput = NULL;
+        hookedArpTable = NULL;
+    }
+
     running = false;
 }
 
 void ArpTable::loop() {
-    if(running && WiFi.status() == WL_CONNECTED && millis() > (lastUpdateTimeMs + updateIntervalMs)) {
-        lastUpdateTimeMs = millis();
-        find(scannedDevice, true);
-    
-        if((scannedDevice == 255) && !repeatedScans) end();
-        else {
-            scannedDevice = (scannedDevice + 1) % 256;
+    if(running && WiFi.status() == WL_CONNECTED) {
+        unsigned long now = millis();
+        if(localNetwork.addr == IPADDR_ANY) setLocalNetwork();
+
+        //addresses learnt from ARP packets since - each settles any device waiting on it:
+        onLearntAddresses();
+        expirePendingResolutions();
+
+        //probe a likely address for the most recently active device still waiting on one - nothing is probed while none are:
+        if((now - lastUpdateTimeMs) >= updateIntervalMs) {
+            PendingResolution *pendingResolution = getDuePendingResolution(now);
+            if(pendingResolution) {
+                lastUpdateTimeMs = now;
+                updateCandidateOrigin(pendingResolution);
+
+                //an address lwIP knows already settles a device at once, and may move this one in the list:
+                int localDevice = nextCandidate(pendingResolution);
+                if(localDevice < 0 || !probe(localDevice)) onPendingProbe(pendingResolution, localDevice >= 0, now);
+            }
         }
     }
 }
 
+bool ArpTable::probe(int localDevice) {
+    bool found = find(localDevice, true);
+
+    //...an answer arrives later, and clears this:
+    if(!found) {
+        uint16_t nowS = millis() / 1000;
+        unansweredAtS[localDevice] = nowS ? nowS : 1;
+    }
+
+    return(found);
+}
+
+bool ArpTable::isRecentlyUnanswered(int localDevice, unsigned long now) {
+    uint16_t nowS = now / 1000;
+    return(unansweredAtS[localDevice] != 0 && (uint16_t) (nowS - unansweredAtS[localDevice]) < (pendingRetryIntervalMs / 1000));
+}
+
+void ArpTable::updateCandidateOrigin(PendingResolution *pendingResolution) {
+    int origin = lastLearntDevice;
+    if(origin < 0) origin = WiFi.localIP()[3];
+
+    //carry on outwards from where it stopped - unless a newer address has been learnt since, leased nearer to it:
+    if(origin != pendingResolution -> candidateOrigin) {
+        pendingResolution -> candidateOrigin = origin;
+        pendingResolution -> candidateOffset = 0;
+    }
+}
+
+int ArpTable::nextCandidate(PendingResolution *pendingResolution) {
+    int localDevice = -1;
+    unsigned long now = millis();
+
+    //alternate either side of its origin, moving outwards - past the addresses known, or lately probed and unanswered:
+    while(localDevice == -1 && pendingResolution -> candidateOffset < 512) {
+        int offset = ++(pendingResolution -> candidateOffset);
+
+        int distance = (offset + 1) / 2;
+        int candidate = pendingResolution -> candidateOrigin + ((offset & 1) ? distance : -distance);
+
+        if(candidate > 0 && candidate < 255 && cache[candidate] == 0 && candidate != WiFi.localIP()[3] && !isRecentlyUnanswered(candidate, now)) localDevice = candidate;
+    }
+
+    //...and start again from the origin next round:
+    if(localDevice == -1) pendingResolution -> candidateOffset = 0;
+
+    return(localDevice);
+}
+
 bool ArpTable::isRunning() {
   return(running);
 }
@@ -60,7 +138,7 @@ bool ArpTable::isRunning() {
 void ArpTable::scan() {
     if(WiFi.status() == WL_CONNECTED) {
         Serial.printf("Building ARP table, takes %i seconds...\t", (minUpdateIntervalMs * 256)/1000);
-        IP4_ADDR(&localNetwork, WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], 0);
+        setLocalNetwork();
 
         //initate a full (blocking) scan:
         for(int n=0; n<256; ++n) {
@@ -75,6 +153,73 @@ void ArpTable::scan() {
     }
 }
 
+void ArpTable::setLocalNetwork() {
+    IP4_ADDR(&localNetwork, WiFi.localIP()[0], WiFi.localIP()[1], WiFi.localIP()[2], 0);
+}
+
+err_t ArpTable::netifInputHook(struct pbuf *p, struct netif *inp) {
+    if(p && hookedArpTable && hookedArpTable -> running) hookedArpTable -> onArpPacket(p);
+
+    return(originalInput ? originalInput(p, inp) : ERR_OK);
+}
+
+void ArpTable::onArpPacket(struct pbuf *p) {
+    //Ethernet header then ARP header - see: https://tools.ietf.org/html/rfc826
+    if(p -> len >= SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR) {
+        uint8_t *frame = (uint8_t *) p -> payload;
+
+        if(((frame[12] << 8) | frame[13]) == ETHTYPE_ARP) {
+            uint8_t *arp = frame + SIZEOF_ETH_HDR;
+
+            //sender hardware address at offset 8, sender protocol address at offset 14:
+            eth_addr senderMacAddress;
+            memcpy(senderMacAddress.addr, arp + 8, ETHARP_HWADDR_LEN);
+
+            ip4_addr_t senderIPAddress;
+            memcpy(&senderIPAddress.addr, arp + 14, sizeof(senderIPAddress.addr));
+
+            if(senderIPAddress.addr != IPADDR_ANY && (senderIPAddress.addr & 0xFFFFFF) == (localNetwork.addr & 0xFFFFFF)) {
+                //queued for loop() - dropped if full, as the next ARP from the same device will be learnt instead:
+                uint32_t head = learntAddressHead;
+                if(head - __atomic_load_n(&learntAddressTail, __ATOMIC_ACQUIRE) < (uint32_t) learntAddressQueueLength) {
+                    LearntAddress &learntAddress = learntAddresses[head & (learntAddressQueueLength - 1)];
+                    learntAddress.hash = getHash(senderMacAddress);
+                    learntAddress.localDevice = (senderIPAddress.addr >> 24) & 0xFF;
+                    __atomic_store_n(&learntAddressHead, head + 1, __ATOMIC_RELEASE);
+                }
+            }
+        }
+    }
+}
+
+void ArpTable::onLearntAddresses() {
+    uint32_t tail = learntAddressTail;
+    uint32_t head = __atomic_load_n(&learntAddressHead, __ATOMIC_ACQUIRE);
+
+    for(; tail != head; ++tail) {
+        LearntAddress &learntAddress = learntAddresses[tail & (learntAddressQueueLength - 1)];
+        setCacheEntry(learntAddress.localDevice, learntAddress.hash);
+    }
+    __atomic_store_n(&learntAddressTail, tail, __ATOMIC_RELEASE);
+}
+
+void ArpTable::setCacheEntry(int localDevice, uint32_t hash) {
+    if(cache[localDevice] != hash) {
+        //a device holds one address - forget any other it was seen at:
+        for(int n=0; n<256; ++n) {
+            if(cache[n] == hash) cache[n] = 0;
+        }
+
+        //...and whichever device held this address before has lost it:
+        cache[localDevice] = hash;
+        unansweredAtS[localDevice] = 0;
+        lastLearntDevice = localDevice;
+    }
+
+    //the device waiting on this address, if any, is settled:
+    removePendingResolution(hash);
+}
+
 bool ArpTable::find(int localDevice, bool requestIfNotFound) {
     ip4_addr_t ipaddr;
     ipaddr.addr = (localNetwork.addr & 0xFFFFFF) | (localDevice << 24);
@@ -95,7 +240,7 @@ bool ArpTable::find(ip4_addr_t &ipaddr, bool requestIfNotFound) {
     }
     else {
         //known - already in ARP table - add to cache
-        cache[(ipaddr.addr >> 24) & 0xFF] = getHash(*eth_ret);
+        setCacheEntry((ipaddr.addr >> 24) & 0xFF, getHash(*eth_ret));
         found = true;
     }
 
@@ -119,9 +264,88 @@ bool ArpTable::lookupIPAddress(Device *device) {
     return(success);
 }
 
+void ArpTable::requestIPAddress(Device *device) {
+    if(running && device && !device -> hasIPAddress()) {
+        eth_addr macAddress;
+        device -> getMacAddress(macAddress);
+        uint32_t hash = getHash(macAddress);
+
+        PendingResolution *pendingResolution = NULL;
+        for(int n=0; n<pendingResolutionCount && !pendingResolution; ++n) {
+            if(pendingResolutions[n].hash == hash) pendingResolution = &pendingResolutions[n];
+        }
+
+        if(!pendingResolution) {
+            if(pendingResolutionCount < maxPendingResolutions) {
+                pendingResolution = &pendingResolutions[pendingResolutionCount++];
+            }
+            else {
+                //full - replace the least recently active:
+                pendingResolution = &pendingResolutions[0];
+                for(int n=1; n<pendingResolutionCount; ++n) {
+                    if(pendingResolutions[n].lastActiveAtMs < pendingResolution -> lastActiveAtMs) pendingResolution = &pendingResolutions[n];
+                }
+            }
+            pendingResolution -> hash = hash;
+            pendingResolution -> probeCount = 0;
+            pendingResolution -> failedRounds = 0;
+            pendingResolution -> retryAtMs = millis();
+            pendingResolution -> candidateOrigin = -1;
+            pendingResolution -> candidateOffset = 0;
+        }
+        pendingResolution -> lastActiveAtMs = millis();
+    }
+}
+
+int ArpTable::getPendingResolutionCount() {
+    return(pendingResolutionCount);
+}
+
+void ArpTable::removePendingResolution(uint32_t hash) {
+    for(int n=0; n<pendingResolutionCount; ++n) {
+        if(pendingResolutions[n].hash == hash) {
+            pendingResolutions[n] = pendingResolutions[--pendingResolutionCount];
+            n--;
+        }
+    }
+}
+
+void ArpTable::expirePendingResolutions() {
+    unsigned long now = millis();
+
+    for(int n=0; n<pendingResolutionCount; ++n) {
+        if((now - pendingResolutions[n].lastActiveAtMs) > pendingResolutionTimeoutMs) {
+            pendingResolutions[n] = pendingResolutions[--pendingResolutionCount];
+            n--;
+        }
+    }
+}
+
+ArpTable::PendingResolution *ArpTable::getDuePendingResolution(unsigned long now) {
+    PendingResolution *pendingResolution = NULL;
+
+    for(int n=0; n<pendingResolutionCount; ++n) {
+        if(pendingResolutions[n].failedRounds != noMoreRounds && (long) (now - pendingResolutions[n].retryAtMs) >= 0) {
+            if(!pendingResolution || pendingResolutions[n].lastActiveAtMs > pendingResolution -> lastActiveAtMs) pendingResolution = &pendingResolutions[n];
+        }
+    }
+
+    return(pendingResolution);
+}
+
+void ArpTable::onPendingProbe(PendingResolution *pendingResolution, bool probed, unsigned long now) {
+    if(!probed || ++pendingResolution -> probeCount >= maxProbesPerRound) {
+        //nothing answered for this device - wait twice as long after each round before trying again:
+        pendingResolution -> probeCount = 0;
+        pendingResolution -> retryAtMs = now + (pendingRetryIntervalMs << min((int) pendingResolution -> failedRounds, (int) maxProbeBackoff));
+        if(!repeatedScans)                                          pendingResolution -> failedRounds = noMoreRounds;
+        else if(pendingResolution -> failedRounds < maxProbeBackoff)   pendingResolution -> failedRounds++;
+    }
+}
 bool ArpTable::lookupIPAddress(eth_addr &macAddress, ip4_addr_t &ipaddr) {
     bool found = false;
 
+    //the cache holds everything lwIP has learnt since begin() - and every ARP packet read since:
     uint32_t hash = getHash(macAddress);
     for(int n=0; n<256 && !found; ++n) {
         if(cache[n] == hash) {
@@ -130,30 +354,15 @@ bool ArpTable::lookupIPAddress(eth_addr &macAddress, ip4_addr_t &ipaddr) {
         }
     }
 
-    if(!found) {
-        ip4_addr_t ipaddrProbe;
-        struct eth_addr *eth_ret;
-        const ip4_addr_t *ip_ret;
-        for(int n=0; n<256 && !found; ++n) {
-            ipaddrProbe.addr = (localNetwork.addr & 0xFFFFFF) | (n << 24);
-
-            if(etharp_find_addr(netif_default, &ipaddrProbe, &eth_ret, &ip_ret) >= 0) {
-                if(eth_addr_cmp(&macAddress, eth_ret)) {
-                    ip4_addr_copy(ipaddr, ipaddrProbe);
-                    found = true;
-                }
-            }
-        }
-    }
+    if(found) removePendingResolution(hash);
 
     return(found);
 }
-
 uint32_t ArpTable::getHash(eth_addr &macAddress) {
-    uint32_t hash = 0;
-
     //last 4 bytes:
-    hash = (macAddress.addr[2] << 24) | (macAddress.addr[3] << 16) | (macAddress.addr[4] << 8) | (macAddress.addr[5] & 0xFF);
+    uint32_t hash = (uint32_t) eth_addr_to_uint64(&macAddress);
 
     return(hash);
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -10,6 +10,7 @@
 #define ArpTable_h
 
 #include <Arduino.h>
+#include "Config.h"
 #include "eth_addr.h"
 
 #if defined(ESP8266)
@@ -24,38 +25,94 @@
 
 class ArpTable {
     private:
-        static uint32_t *cache;
-        static ip4_addr_t localNetwork;
-
-        static bool running;
+        uint32_t cache[256] = {0};
+        ip4_addr_t localNetwork = {0};
+        void setLocalNetwork();
+
+        //passive learning - ARP replies and gratuitous ARPs are read as they arrive on the netif:
+        static netif_input_fn originalInput;
+        static ArpTable *hookedArpTable;    //there is one netif, so at most one table is hooked at a time
+        static err_t netifInputHook(struct pbuf *p, struct netif *inp);
+        void onArpPacket(struct pbuf *p);
+
+        //...in the lwIP task, so they are only queued there and written to the cache from loop():
+        typedef struct {
+            uint32_t hash;
+            uint8_t localDevice;
+        } LearntAddress;
+
+        static const int learntAddressQueueLength = 16;
+        LearntAddress learntAddresses[learntAddressQueueLength];
+        uint32_t learntAddressHead = 0;
+        uint32_t learntAddressTail = 0;
+        void onLearntAddresses();
+        void setCacheEntry(int localDevice, uint32_t hash);
+
+        bool running = false;
         bool repeatedScans = true;
 
-        int updateIntervalMs;
+        unsigned long updateIntervalMs;
         static const int minUpdateIntervalMs;
-        int lastUpdateTimeMs;
+        unsigned long lastUpdateTimeMs;
 
-        ArpTable(int updateIntervalMs = 500, bool repeatedScans = true);
         ArpTable(ArpTable const&);
         void operator=(ArpTable const&);
 
-        static bool find(int localDevice, bool requestIfNotFound);
-        static bool find(ip4_addr_t &ipaddr, bool requestIfNotFound);
-        int scannedDevice = 0;
+        bool find(int localDevice, bool requestIfNotFound);
+        bool find(ip4_addr_t &ipaddr, bool requestIfNotFound);
+        bool probe(int localDevice);
+
+        //demand-driven resolution - only the sniffed devices still waiting on an IP address are probed for:
+        typedef struct {
+            uint32_t hash;
+            unsigned long lastActiveAtMs;
+            uint8_t probeCount;         //probes made for it since it last backed off
+            uint8_t failedRounds;       //rounds of probes that found nothing
+            unsigned long retryAtMs;    //no probes are made for it before this
+            int candidateOrigin;        //its likely addresses - either side of the one most recently learnt...
+            int candidateOffset;        //...and how far out it has reached
+        } PendingResolution;
+
+        static const int maxPendingResolutions = 16;
+        static const unsigned long pendingResolutionTimeoutMs = 60000;
+        static const int maxProbesPerRound = 16;
+        static const unsigned long pendingRetryIntervalMs = 60000;
+        PendingResolution pendingResolutions[maxPendingResolutions];
+        int pendingResolutionCount = 0;
+        void removePendingResolution(uint32_t hash);
+        void expirePendingResolutions();
+        PendingResolution *getDuePendingResolution(unsigned long now);
+        void updateCandidateOrigin(PendingResolution *pendingResolution);
+        void onPendingProbe(PendingResolution *pendingResolution, bool probed, unsigned long now);
+
+        //likely addresses - the unknown addresses either side of the one most recently learnt, as a DHCP server leases them in turn:
+        int lastLearntDevice = -1;
+        int nextCandidate(PendingResolution *pendingResolution);
+
+        //per address back-off - an unanswered address is not probed again, for any device, until the retry interval has passed:
+        uint16_t unansweredAtS[256] = {0};  //seconds, wrapping - 0 if answered or never probed
+        bool isRecentlyUnanswered(int localDevice, unsigned long now);
+        static const int maxProbeBackoff = 5;
+        static const uint8_t noMoreRounds = 0xFF;   //failedRounds once a device has given up, without repeated scans
 
         static uint32_t getHash(eth_addr &macAddress);
 
     public:
-        static ArpTable* getInstance(int updateIntervalMs = 1000, bool repeatedScans = true);
+        ArpTable(int updateIntervalMs = 1000, bool repeatedScans = true);
 
         void begin();
         void end();
         void loop();
         bool isRunning();
 
-        static bool lookupIPAddress(Device *device);
-        static bool lookupIPAddress(eth_addr &macAddress, ip4_addr_t &ipaddr);
+        //from loop() - never from the WiFi task:
+        bool lookupIPAddress(Device *device);
+        bool lookupIPAddress(eth_addr &macAddress, ip4_addr_t &ipaddr);
+
+        void requestIPAddress(Device *device);
+        int getPendingResolutionCount();
 
-        static void scan();
+        void scan();
 };
 
 #endif
\ No newline at end of file
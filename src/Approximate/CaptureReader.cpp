@@ -0,0 +1,311 @@
+/*
+    CaptureReader.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "CaptureReader.h"
+
+//radiotap fields are always little-endian, as is most capture data - see: https://www.radiotap.org/
+static uint16_t littleEndian16(const uint8_t *p) {
+    return((uint16_t) (p[0] | (p[1] << 8)));
+}
+
+static uint32_t littleEndian32(const uint8_t *p) {
+    return((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+CaptureFrame::CaptureFrame() {
+}
+
+const uint8_t *CaptureFrame::getFrame() {
+    return(frame);
+}
+
+uint16_t CaptureFrame::getFrameLength() {
+    //a trailing FCS is only known once the radiotap flags are read:
+    decodeRadiotap();
+    return(frameLength);
+}
+
+int CaptureFrame::getType() {
+    int type = -1;
+
+    if(frame && frameLength >= 2) type = WIFI_FCTL_TYPE(frame[0] | (frame[1] << 8));
+
+    return(type);
+}
+
+uint64_t CaptureFrame::getTimestampUs() {
+    return(timestampUs);
+}
+
+uint64_t CaptureFrame::getTimestampMs() {
+    return(timestampUs / 1000);
+}
+
+int CaptureFrame::getRSSI() {
+    decodeRadiotap();
+    return(rssi);
+}
+
+int CaptureFrame::getChannel() {
+    decodeRadiotap();
+    return(channel);
+}
+
+void CaptureFrame::decodeRadiotap() {
+    if(!decoded && radiotap && radiotapLength >= 8) {
+        //the present bitmaps are chained by bit 31 - fields start after the last:
+        uint32_t present = littleEndian32(radiotap + 4);
+        uint16_t offset = 8;
+        for(uint32_t word = present; (word & 0x80000000) && offset + 4 <= radiotapLength; offset += 4) {
+            word = littleEndian32(radiotap + offset);
+        }
+
+        //fields 0 to 5 in order, each aligned to its natural size - {alignment, size}:
+        static const uint8_t fields[6][2] = {{8, 8}, {1, 1}, {1, 1}, {2, 4}, {1, 2}, {1, 1}};
+
+        bool overrun = false;
+        for(int bit = 0; bit < 6 && !overrun; ++bit) {
+            if(present & (1 << bit)) {
+                uint8_t alignment = fields[bit][0];
+                offset = (offset + alignment - 1) & ~(alignment - 1);
+
+                if(offset + fields[bit][1] > radiotapLength) overrun = true;
+                else {
+                    const uint8_t *field = radiotap + offset;
+                    switch(bit) {
+                        case 1:
+                            //flags - 0x10, the frame includes the FCS:
+                            if((field[0] & 0x10) && frameLength >= 4) frameLength -= 4;
+                            break;
+                        case 3: {
+                            uint16_t frequencyMHz = littleEndian16(field);
+                            if(frequencyMHz == 2484)                                    channel = 14;
+                            else if(frequencyMHz >= 2412 && frequencyMHz < 2484)        channel = (frequencyMHz - 2407) / 5;
+                            else if(frequencyMHz >= 5000 && frequencyMHz < 5900)        channel = (frequencyMHz - 5000) / 5;
+                            break;
+                        }
+                        case 5:
+                            rssi = (int8_t) field[0];
+                            break;
+                    }
+                    offset += fields[bit][1];
+                }
+            }
+        }
+    }
+    decoded = true;
+}
+
+CaptureReader::CaptureReader() {
+}
+
+bool CaptureReader::begin(const uint8_t *data, size_t length) {
+    bool success = false;
+
+    this -> data = data;
+    this -> length = length;
+    pcapng = false;
+    linkType = 0;
+
+    if(data && length >= 24) {
+        uint32_t magic = littleEndian32(data);
+
+        if(magic == 0xA1B2C3D4 || magic == 0xA1B23C4D) {
+            bigEndian = false;
+            success = true;
+        }
+        else if(magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1) {
+            bigEndian = true;
+            success = true;
+        }
+        else if(magic == 0x0A0D0D0A) {
+            //the byte-order magic decides how the rest of the section is read:
+            pcapng = true;
+            bigEndian = littleEndian32(data + 8) != 0x1A2B3C4D;
+            success = true;
+        }
+
+        if(success && !pcapng) {
+            nanosecondResolution = (read32(0) == 0xA1B23C4D);
+            linkType = read32(20);
+            success = (linkType == LINKTYPE_IEEE802_11 || linkType == LINKTYPE_IEEE802_11_RADIOTAP);
+        }
+    }
+
+    rewind();
+
+    return(success);
+}
+
+void CaptureReader::rewind() {
+    offset = pcapng ? 0 : 24;
+    interfaceCount = 0;
+    frameCount = 0;
+}
+
+int CaptureReader::getLinkType() {
+    return(linkType);
+}
+
+uint32_t CaptureReader::getFrameCount() {
+    return(frameCount);
+}
+
+bool CaptureReader::next(CaptureFrame &frame) {
+    bool success = false;
+
+    if(data) {
+        success = pcapng ? nextPcapngFrame(frame) : nextPcapFrame(frame);
+        if(success) frameCount++;
+    }
+
+    return(success);
+}
+
+bool CaptureReader::nextPcapFrame(CaptureFrame &frame) {
+    bool success = false;
+
+    while(!success && offset + 16 <= length) {
+        uint32_t seconds = read32(offset);
+        uint32_t fraction = read32(offset + 4);
+        uint32_t capturedLength = read32(offset + 8);
+
+        if(capturedLength > length - offset - 16) {
+            //truncated - stop here:
+            offset = length;
+        }
+        else {
+            uint64_t timestampUs = (uint64_t) seconds * 1000000 + (nanosecondResolution ? fraction / 1000 : fraction);
+            success = setFrame(frame, linkType, data + offset + 16, capturedLength, timestampUs);
+            offset += 16 + capturedLength;
+        }
+    }
+
+    return(success);
+}
+
+bool CaptureReader::nextPcapngFrame(CaptureFrame &frame) {
+    bool success = false;
+
+    while(!success && offset + 12 <= length) {
+        uint32_t blockType = littleEndian32(data + offset);
+
+        //a new section may change the byte order - the block length is read after:
+        if(blockType == 0x0A0D0D0A) {
+            bigEndian = littleEndian32(data + offset + 8) != 0x1A2B3C4D;
+            interfaceCount = 0;
+        }
+        else blockType = read32(offset);
+
+        uint32_t blockLength = read32(offset + 4);
+        if(blockLength < 12 || blockLength > length - offset) {
+            offset = length;
+        }
+        else {
+            if(blockType == 1) {
+                parseInterfaceDescription(offset, blockLength);
+            }
+            else if(blockType == 6 && blockLength >= 32) {
+                //enhanced packet block:
+                uint32_t interfaceId = read32(offset + 8);
+                uint64_t timestamp = ((uint64_t) read32(offset + 12) << 32) | read32(offset + 16);
+                uint32_t capturedLength = read32(offset + 20);
+
+                if(interfaceId < (uint32_t) min(interfaceCount, (int) maxInterfaces) && capturedLength <= blockLength - 32) {
+                    uint64_t unitsPerSecond = interfaceUnitsPerSecond[interfaceId];
+                    uint64_t timestampUs;
+                    if(unitsPerSecond <= (1ULL << 44)) {
+                        //whole seconds and the remainder apart, so that binary units (2^-n) scale exactly - without overflow:
+                        timestampUs = ((timestamp / unitsPerSecond) * 1000000) + (((timestamp % unitsPerSecond) * 1000000) / unitsPerSecond);
+                    }
+                    else timestampUs = timestamp / (unitsPerSecond / 1000000);
+
+                    linkType = interfaceLinkType[interfaceId];
+                    success = setFrame(frame, linkType, data + offset + 28, capturedLength, timestampUs);
+                }
+            }
+            offset += blockLength;
+        }
+    }
+
+    return(success);
+}
+
+void CaptureReader::parseInterfaceDescription(size_t at, uint32_t blockLength) {
+    if(interfaceCount < maxInterfaces && blockLength >= 20) {
+        uint64_t unitsPerSecond = 1000000;
+
+        //options follow the fixed fields - if_tsresol (9) sets the timestamp units:
+        size_t option = at + 16;
+        size_t end = at + blockLength - 4;
+        while(option + 4 <= end) {
+            uint16_t code = read16(option);
+            uint16_t optionLength = read16(option + 2);
+            if(code == 0 || option + 4 + optionLength > end) break;
+
+            if(code == 9 && optionLength >= 1) {
+                uint8_t resolution = data[option + 4];
+                uint8_t exponent = resolution & 0x7F;
+                if(resolution & 0x80)   unitsPerSecond = exponent < 64 ? (1ULL << exponent) : 1000000;
+                else {
+                    unitsPerSecond = 1;
+                    for(int n=0; n<exponent && n<19; ++n) unitsPerSecond *= 10;
+                }
+            }
+
+            option += 4 + ((optionLength + 3) & ~3);
+        }
+
+        interfaceLinkType[interfaceCount] = read16(at + 8);
+        interfaceUnitsPerSecond[interfaceCount] = unitsPerSecond;
+    }
+    interfaceCount++;
+}
+
+bool CaptureReader::setFrame(CaptureFrame &frame, uint32_t linkType, const uint8_t *bytes, uint32_t capturedLength, uint64_t timestampUs) {
+    bool success = false;
+
+    frame.radiotap = NULL;
+    frame.radiotapLength = 0;
+    frame.frame = NULL;
+    frame.frameLength = 0;
+    frame.decoded = false;
+    frame.rssi = 0;
+    frame.channel = 0;
+    frame.timestampUs = timestampUs;
+
+    if(linkType == LINKTYPE_IEEE802_11_RADIOTAP) {
+        if(capturedLength >= 8) {
+            uint16_t radiotapLength = littleEndian16(bytes + 2);
+            if(radiotapLength >= 8 && radiotapLength <= capturedLength) {
+                frame.radiotap = bytes;
+                frame.radiotapLength = radiotapLength;
+                frame.frame = bytes + radiotapLength;
+                frame.frameLength = min(capturedLength - radiotapLength, (uint32_t) 0xFFFF);
+                success = true;
+            }
+        }
+    }
+    else if(linkType == LINKTYPE_IEEE802_11) {
+        frame.frame = bytes;
+        frame.frameLength = min(capturedLength, (uint32_t) 0xFFFF);
+        success = true;
+    }
+
+    return(success);
+}
+
+uint16_t CaptureReader::read16(size_t at) {
+    const uint8_t *p = data + at;
+    return(bigEndian ? (uint16_t) ((p[0] << 8) | p[1]) : littleEndian16(p));
+}
+
+uint32_t CaptureReader::read32(size_t at) {
+    const uint8_t *p = data + at;
+    return(bigEndian ? ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3] : littleEndian32(p));
+}
@@ -0,0 +1,92 @@
+/*
+    CaptureReader.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef CaptureReader_h
+#define CaptureReader_h
+
+#include <Arduino.h>
+#include "eth_addr.h"
+#include "wifi_pkt.h"
+
+//A view of one captured frame - it points into the capture, so is only valid while the capture stays mapped:
+class CaptureFrame {
+    public:
+        CaptureFrame();
+
+        const uint8_t *getFrame();
+        uint16_t getFrameLength();
+        int getType();
+
+        uint64_t getTimestampUs();
+        uint64_t getTimestampMs();
+
+        //decoded from the radiotap header on first use - 0 if it is absent:
+        int getRSSI();
+        int getChannel();
+
+    private:
+        friend class CaptureReader;
+
+        const uint8_t *radiotap = NULL;
+        uint16_t radiotapLength = 0;
+        const uint8_t *frame = NULL;
+        uint16_t frameLength = 0;
+        uint64_t timestampUs = 0;
+
+        bool decoded = false;
+        int rssi = 0;
+        int channel = 0;
+
+        void decodeRadiotap();
+};
+
+//Walks a pcap or pcapng capture of 802.11 frames in place - the capture is mapped (or loaded) by the caller:
+class CaptureReader {
+    public:
+        CaptureReader();
+
+        bool begin(const uint8_t *data, size_t length);
+        bool next(CaptureFrame &frame);
+        void rewind();
+
+        int getLinkType();
+        uint32_t getFrameCount();
+
+    private:
+        CaptureReader(CaptureReader const&);
+        void operator=(CaptureReader const&);
+
+        static const uint32_t LINKTYPE_IEEE802_11 = 105;
+        static const uint32_t LINKTYPE_IEEE802_11_RADIOTAP = 127;
+        static const int maxInterfaces = 4;
+
+        const uint8_t *data = NULL;
+        size_t length = 0;
+        size_t offset = 0;
+
+        bool pcapng = false;
+        bool bigEndian = false;
+        bool nanosecondResolution = false;
+        uint32_t linkType = 0;
+        uint32_t frameCount = 0;
+
+        //pcapng only - per interface description block:
+        int interfaceCount = 0;
+        uint32_t interfaceLinkType[maxInterfaces];
+        uint64_t interfaceUnitsPerSecond[maxInterfaces];
+
+        uint16_t read16(size_t at);
+        uint32_t read32(size_t at);
+
+        bool nextPcapFrame(CaptureFrame &frame);
+        bool nextPcapngFrame(CaptureFrame &frame);
+        void parseInterfaceDescription(size_t at, uint32_t blockLength);
+        bool setFrame(CaptureFrame &frame, uint32_t linkType, const uint8_t *bytes, uint32_t capturedLength, uint64_t timestampUs);
+};
+
+#endif
@@ -25,6 +25,7 @@ void Channel::getBssid(eth_addr &bssid) {
      ETHADDR16_COPY(&bssid, &this -> bssid);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 String Channel::getBssidAsString() {
     String bssidAsString = "";
 
@@ -32,6 +33,7 @@ String Channel::getBssidAsString() {
 
     return(bssidAsString);
 }
+#endif
 
 char *Channel::getBssidAs_c_str(char *out) {
     Approximate::eth_addr_to_c_str(bssid, out);
@@ -10,6 +10,7 @@
 #define Channel_h
 
 #include <Arduino.h>
+#include "Config.h"
 #include "eth_addr.h"
 
 class Channel {
@@ -23,7 +24,9 @@ class Channel {
         void init(eth_addr &bssid, int channel);
 
         void getBssid(eth_addr &bssid);
+        #if APPROXIMATE_STRING_API_ENABLED
         String getBssidAsString();
+        #endif
         char *getBssidAs_c_str(char *out);
         void setBssid(eth_addr &bssid);
 
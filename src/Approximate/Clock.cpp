@@ -0,0 +1,66 @@
+/*
+    Clock.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Clock.h"
+
+#if defined(ESP32)
+    #define CLOCK_ENTER_CRITICAL()  portENTER_CRITICAL(&timeMux)
+    #define CLOCK_EXIT_CRITICAL()   portEXIT_CRITICAL(&timeMux)
+#else
+    //the ESP8266's WiFi callbacks never preempt loop():
+    #define CLOCK_ENTER_CRITICAL()
+    #define CLOCK_EXIT_CRITICAL()
+#endif
+
+Clock::Clock() {
+}
+
+uint64_t Clock::getTimeMs() {
+    uint64_t now = 0;
+
+    if(virtualTime) {
+        CLOCK_ENTER_CRITICAL();
+        now = timeMs;
+        CLOCK_EXIT_CRITICAL();
+    }
+    else {
+        now = getSystemTimeMs();
+    }
+
+    return(now);
+}
+
+uint64_t Clock::getSystemTimeMs() {
+    #if defined(ESP32)
+        return((uint64_t) esp_timer_get_time() / 1000);
+    #else
+        return(micros64() / 1000);
+    #endif
+}
+
+void Clock::setTimeMs(uint64_t timeMs) {
+    CLOCK_ENTER_CRITICAL();
+    this -> timeMs = timeMs;
+    virtualTime = true;
+    CLOCK_EXIT_CRITICAL();
+}
+
+void Clock::advanceMs(uint32_t intervalMs) {
+    uint64_t systemTimeMs = getSystemTimeMs();
+
+    CLOCK_ENTER_CRITICAL();
+    //from the real time, if not yet virtual:
+    if(!virtualTime) timeMs = systemTimeMs;
+    timeMs += intervalMs;
+    virtualTime = true;
+    CLOCK_EXIT_CRITICAL();
+}
+
+bool Clock::isVirtual() {
+    return(virtualTime);
+}
@@ -0,0 +1,43 @@
+/*
+    Clock.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Clock_h
+#define Clock_h
+
+#include <Arduino.h>
+
+#if defined(ESP32)
+    #include <esp_timer.h>
+#endif
+
+//Milliseconds as a 64-bit count that never wraps - follows the system timer, or for replay is set by hand:
+//
+//Frames are stamped on the WiFi task while loop() reads the clock too, so the real time is taken from the 64-bit system timer
+//without any state of its own, and a virtual time is only read or written within a critical section.
+class Clock {
+    public:
+        Clock();
+
+        uint64_t getTimeMs();
+
+        //a virtual clock only moves when it is set or advanced - so a capture can be replayed faster than real time:
+        void setTimeMs(uint64_t timeMs);
+        void advanceMs(uint32_t intervalMs);
+        bool isVirtual();
+
+    private:
+        volatile bool virtualTime = false;
+        uint64_t timeMs = 0;
+        static uint64_t getSystemTimeMs();
+
+        #if defined(ESP32)
+            portMUX_TYPE timeMux = portMUX_INITIALIZER_UNLOCKED;
+        #endif
+};
+
+#endif
@@ -0,0 +1,365 @@
+/*
+    Collector.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Collector.h"
+
+#if APPROXIMATE_COLLECTOR_ENABLED
+
+Collector::Collector(int shardCount) {
+    this -> shardCount = constrain(shardCount, 1, maxShards);
+
+    memset(shards, 0, sizeof(shards));
+}
+
+int Collector::getShardCount() {
+    return(shardCount);
+}
+
+int Collector::ingest(const uint8_t *batch, int lengthBytes) {
+    return(ingest(batch, lengthBytes, clock.getTimeMs()));
+}
+
+int Collector::ingest(const uint8_t *batch, int lengthBytes, uint64_t receivedAtMs) {
+    int queuedCount = 0;
+
+    uint16_t nodeId;
+    uint16_t sequence;
+    int count = ObservationBatch::decodeHeader(batch, lengthBytes, nodeId, sequence);
+    if(count > 0) {
+        checkSequence(nodeId, sequence);
+        uint64_t sentAtMs = ObservationBatch::decodeSentAtMs(batch);
+
+        for(int n = 0; n < count; ++n) {
+            Observation observation;
+            ObservationBatch::decode(batch, n, nodeId, observation);
+
+            //from the node's clock to the collector's - transit time is taken as nil:
+            uint64_t ageMs = sentAtMs - observation.timeMs;
+            observation.timeMs = receivedAtMs > ageMs ? receivedAtMs - ageMs : 0;
+
+            Shard &shard = shards[Device::getShardIndex(observation.macAddress, shardCount)];
+            uint32_t head = shard.head;
+            if(head - __atomic_load_n(&shard.tail, __ATOMIC_ACQUIRE) < (uint32_t) shardQueueLength) {
+                shard.queue[head & (shardQueueLength - 1)] = observation;
+                __atomic_store_n(&shard.head, head + 1, __ATOMIC_RELEASE);
+                queuedCount++;
+            }
+            else droppedObservationCount++;
+        }
+        ingestedObservationCount += queuedCount;
+    }
+
+    return(queuedCount);
+}
+
+int Collector::process(int shardIndex) {
+    int appliedCount = 0;
+
+    if(shardIndex >= 0 && shardIndex < shardCount) {
+        Shard &shard = shards[shardIndex];
+
+        uint32_t tail = shard.tail;
+        uint32_t head = __atomic_load_n(&shard.head, __ATOMIC_ACQUIRE);
+        for(; tail != head; ++tail, ++appliedCount) {
+            update(shard, shard.queue[tail & (shardQueueLength - 1)]);
+        }
+        __atomic_store_n(&shard.tail, tail, __ATOMIC_RELEASE);
+    }
+
+    return(appliedCount);
+}
+
+void Collector::update(Shard &shard, Observation &observation) {
+    DeviceState *state = NULL;
+    DeviceState *empty = NULL;
+    DeviceState *oldest = NULL;
+
+    int slot = getSlot(observation.macAddress);
+    for(int n = 0; n < maxProbes && !state && !empty; ++n) {
+        DeviceState *s = &shard.devices[(slot + n) & (maxDevicesPerShard - 1)];
+
+        if(s -> macAddress == observation.macAddress)   state = s;
+        else if(s -> macAddress == 0)                   empty = s;
+        else if(!oldest || s -> lastSeenAtMs < oldest -> lastSeenAtMs) oldest = s;
+    }
+
+    if(!state) {
+        //a new device - take an empty slot, or else the stalest on its probe sequence:
+        if(empty)   shard.deviceCount++;
+        else        shard.evictedDeviceCount++;
+
+        state = empty ? empty : oldest;
+        memset(state, 0, sizeof(DeviceState));
+        state -> macAddress = observation.macAddress;
+        state -> nearestNodeId = -1;
+    }
+
+    //observations from different nodes may arrive out of order - even once on the collector's clock:
+    if(observation.timeMs >= state -> lastSeenAtMs) {
+        state -> lastSeenAtMs = observation.timeMs;
+        state -> nodeId = observation.nodeId;
+        state -> rssi = observation.rssi;
+        state -> channel = observation.channel;
+    }
+    state -> observationCount++;
+
+    fuse(*state, observation);
+}
+
+void Collector::fuse(DeviceState &state, Observation &observation) {
+    uint32_t nowMs = observation.timeMs;
+
+    //this node's reading - or else an unused or stale one, or else the weakest:
+    Reading *reading = NULL;
+    Reading *replaceable = NULL;
+    for(int n = 0; n < maxReadings && !reading; ++n) {
+        Reading *r = &state.readings[n];
+
+        if(r -> rssi != 0 && r -> nodeId == observation.nodeId)    reading = r;
+        else if(!replaceable)                                       replaceable = r;
+        else if(isFresh(*replaceable, nowMs) && (!isFresh(*r, nowMs) || r -> rssi < replaceable -> rssi)) replaceable = r;
+    }
+
+    int rssi = observation.rssi * 16;
+
+    //a weak newcomer doesn't displace stronger recent readings:
+    if(!reading && !(isFresh(*replaceable, nowMs) && rssi <= replaceable -> rssi)) {
+        reading = replaceable;
+        reading -> nodeId = observation.nodeId;
+        reading -> rssi = 0;
+    }
+
+    if(reading) {
+        if(isFresh(*reading, nowMs))    reading -> rssi += (rssi - reading -> rssi) / 4;
+        else                            reading -> rssi = rssi;
+        if(reading -> rssi == 0) reading -> rssi = -1;   //0 marks an unused reading
+
+        //readings only move forward in time, whatever order they arrive in:
+        if(!isFresh(*reading, nowMs) || (int32_t) (nowMs - reading -> lastSeenAtMs) > 0) reading -> lastSeenAtMs = nowMs;
+
+        updateNearestNode(state, nowMs);
+        if(positionMethod != NONE) updatePosition(state, nowMs);
+    }
+}
+
+void Collector::updateNearestNode(DeviceState &state, uint32_t nowMs) {
+    Reading *strongest = NULL;
+    Reading *nearest = NULL;
+    for(int n = 0; n < maxReadings; ++n) {
+        Reading *r = &state.readings[n];
+
+        if(isFresh(*r, nowMs)) {
+            if(!strongest || r -> rssi > strongest -> rssi) strongest = r;
+            if((int32_t) r -> nodeId == state.nearestNodeId) nearest = r;
+        }
+    }
+
+    //hysteresis - the nearest node only changes once another is clearly stronger:
+    if(strongest && strongest != nearest && (!nearest || strongest -> rssi > nearest -> rssi + (nearestNodeMarginDb * 16))) {
+        int32_t lastNearestNodeId = state.nearestNodeId;
+        state.nearestNodeId = strongest -> nodeId;
+
+        if(nearestNodeHandler) nearestNodeHandler(&state, lastNearestNodeId);
+    }
+}
+
+void Collector::updatePosition(DeviceState &state, uint32_t nowMs) {
+    float x[maxReadings];
+    float y[maxReadings];
+    float d[maxReadings];
+    int count = 0;
+
+    for(int n = 0; n < maxReadings; ++n) {
+        Reading &r = state.readings[n];
+        NodePosition *position = isFresh(r, nowMs) ? getNodePosition(r.nodeId) : NULL;
+        if(position) {
+            x[count] = position -> x;
+            y[count] = position -> y;
+            d[count] = getDistance(r.rssi / 16);
+            count++;
+        }
+    }
+
+    bool hasPosition = false;
+    if(positionMethod == TRILATERATION && count >= 3) {
+        //linearised against the first node, then solved by the 2x2 normal equations:
+        float a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+        for(int n = 1; n < count; ++n) {
+            float ax = 2 * (x[n] - x[0]);
+            float ay = 2 * (y[n] - y[0]);
+            float b = (d[0] * d[0]) - (d[n] * d[n]) + (x[n] * x[n]) - (x[0] * x[0]) + (y[n] * y[n]) - (y[0] * y[0]);
+            a11 += ax * ax;
+            a12 += ax * ay;
+            a22 += ay * ay;
+            b1 += ax * b;
+            b2 += ay * b;
+        }
+
+        float determinant = (a11 * a22) - (a12 * a12);
+        if(fabs(determinant) > 1e-6) {
+            state.x = ((a22 * b1) - (a12 * b2)) / determinant;
+            state.y = ((a11 * b2) - (a12 * b1)) / determinant;
+            hasPosition = true;
+        }
+    }
+
+    if(!hasPosition && count >= 1) {
+        //nodes in a line can't be trilaterated - fall back to the centroid:
+        float weights = 0, wx = 0, wy = 0;
+        for(int n = 0; n < count; ++n) {
+            float weight = 1.0 / max(d[n], 0.1f);
+            weights += weight;
+            wx += weight * x[n];
+            wy += weight * y[n];
+        }
+        state.x = wx / weights;
+        state.y = wy / weights;
+        hasPosition = true;
+    }
+
+    state.hasPosition = hasPosition;
+}
+
+float Collector::getDistance(int rssi) {
+    //log-distance path loss:
+    return(pow(10.0, (rssiAtOneMetre - rssi) / (10.0 * pathLossExponent)));
+}
+
+bool Collector::isFresh(Reading &reading, uint32_t nowMs) {
+    //readings from other nodes' batches may be a little ahead, so the difference is signed:
+    return(reading.rssi != 0 && (int32_t) (nowMs - reading.lastSeenAtMs) <= fusionWindowMs);
+}
+
+Collector::NodePosition *Collector::getNodePosition(uint16_t nodeId) {
+    NodePosition *position = NULL;
+
+    for(int n = 0; n < nodePositionCount && !position; ++n) {
+        if(nodePositions[n].nodeId == nodeId) position = &nodePositions[n];
+    }
+
+    return(position);
+}
+
+bool Collector::setNodePosition(uint16_t nodeId, float x, float y) {
+    NodePosition *position = getNodePosition(nodeId);
+
+    if(!position && nodePositionCount < maxNodes) {
+        position = &nodePositions[nodePositionCount++];
+        position -> nodeId = nodeId;
+    }
+
+    if(position) {
+        position -> x = x;
+        position -> y = y;
+    }
+
+    return(position != NULL);
+}
+
+void Collector::setPositionMethod(PositionMethod positionMethod) {
+    this -> positionMethod = positionMethod;
+}
+
+void Collector::setPathLoss(int rssiAtOneMetre, float exponent) {
+    this -> rssiAtOneMetre = rssiAtOneMetre;
+    this -> pathLossExponent = max(exponent, 1.0f);
+}
+
+void Collector::setFusionWindowMs(int fusionWindowMs) {
+    this -> fusionWindowMs = max(fusionWindowMs, 0);
+}
+
+void Collector::setNearestNodeMarginDb(int nearestNodeMarginDb) {
+    this -> nearestNodeMarginDb = max(nearestNodeMarginDb, 0);
+}
+
+void Collector::setNearestNodeHandler(NearestNodeHandler nearestNodeHandler) {
+    this -> nearestNodeHandler = nearestNodeHandler;
+}
+
+int Collector::getSlot(uint64_t macAddressKey) {
+    //a different hash to the shard's, so that slots are spread within it:
+    return((int) ((macAddressKey * 0x9E3779B97F4A7C15ULL) >> 40) & (maxDevicesPerShard - 1));
+}
+
+void Collector::checkSequence(uint16_t nodeId, uint16_t sequence) {
+    int node = -1;
+    for(int n = 0; n < nodeCount && node < 0; ++n) {
+        if(nodeIds[n] == nodeId) node = n;
+    }
+
+    if(node < 0) {
+        if(nodeCount < maxNodes) {
+            node = nodeCount++;
+            nodeIds[node] = nodeId;
+            nextSequences[node] = sequence;
+        }
+    }
+
+    if(node >= 0) {
+        //a gap is lost batches, a step back is a duplicate or reordered batch:
+        uint16_t gap = sequence - nextSequences[node];
+        if(gap < 0x8000) {
+            lostBatchCount += gap;
+            nextSequences[node] = sequence + 1;
+        }
+    }
+}
+
+bool Collector::getDeviceState(eth_addr &macAddress, DeviceState &state) {
+    return(getDeviceState(eth_addr_to_uint64(&macAddress), state));
+}
+
+bool Collector::getDeviceState(uint64_t macAddressKey, DeviceState &state) {
+    bool found = false;
+
+    if(macAddressKey != 0) {
+        Shard &shard = shards[Device::getShardIndex(macAddressKey, shardCount)];
+
+        int slot = getSlot(macAddressKey);
+        for(int n = 0; n < maxProbes && !found; ++n) {
+            DeviceState &s = shard.devices[(slot + n) & (maxDevicesPerShard - 1)];
+            if(s.macAddress == macAddressKey) {
+                state = s;
+                found = true;
+            }
+        }
+    }
+
+    return(found);
+}
+
+int Collector::getDeviceCount() {
+    int deviceCount = 0;
+
+    for(int n = 0; n < shardCount; ++n) deviceCount += shards[n].deviceCount;
+
+    return(deviceCount);
+}
+
+uint32_t Collector::getIngestedObservationCount() {
+    return(ingestedObservationCount);
+}
+
+uint32_t Collector::getDroppedObservationCount() {
+    return(droppedObservationCount);
+}
+
+uint32_t Collector::getLostBatchCount() {
+    return(lostBatchCount);
+}
+
+uint32_t Collector::getEvictedDeviceCount() {
+    uint32_t evictedDeviceCount = 0;
+
+    for(int n = 0; n < shardCount; ++n) evictedDeviceCount += shards[n].evictedDeviceCount;
+
+    return(evictedDeviceCount);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*
+    Collector.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Collector_h
+#define Collector_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "eth_addr.h"
+
+#include "Clock.h"
+#include "Device.h"
+#include "Observation.h"
+
+//Gathers the observations sent by many nodes' Reporters - device state is sharded by address, so each shard can be processed by its own task or thread:
+class Collector {
+    public:
+        static const int maxShards = APPROXIMATE_COLLECTOR_MAX_SHARDS;
+        static const int shardQueueLength = APPROXIMATE_COLLECTOR_QUEUE_LENGTH;
+        static const int maxDevicesPerShard = APPROXIMATE_COLLECTOR_MAX_DEVICES;
+        static const int maxNodes = 16;
+        static const int maxReadings = 4;               //nodes fused for each device - the strongest recent
+
+        //the RSSI of a device at one node, smoothed over the fusion window:
+        typedef struct {
+            uint16_t nodeId;
+            int16_t rssi;           //in 1/16 dBm, 0 if unused
+            uint32_t lastSeenAtMs;  //low 32 bits of the collector's clock
+        } Reading;
+
+        typedef struct {
+            uint64_t macAddress;    //0 if unused
+            uint64_t lastSeenAtMs;
+            uint32_t observationCount;
+            uint16_t nodeId;        //of the most recent observation
+            int8_t rssi;
+            uint8_t channel;
+
+            Reading readings[maxReadings];
+            int32_t nearestNodeId;  //-1 if none
+            bool hasPosition;
+            float x;
+            float y;
+        } DeviceState;
+
+        enum PositionMethod {
+            NONE,
+            CENTROID,       //weighted by the inverse of each node's estimated distance - one node or more
+            TRILATERATION   //least squares over the estimated distances - three nodes or more, otherwise the centroid
+        };
+
+        typedef void (*NearestNodeHandler)(DeviceState *state, int32_t lastNearestNodeId);
+
+        Collector(int shardCount = 1);
+        int getShardCount();
+
+        //fusion across nodes - set up before processing starts:
+        bool setNodePosition(uint16_t nodeId, float x, float y);
+        void setPositionMethod(PositionMethod positionMethod);
+        void setPathLoss(int rssiAtOneMetre = -45, float exponent = 2.5);
+        void setFusionWindowMs(int fusionWindowMs);
+        void setNearestNodeMarginDb(int nearestNodeMarginDb);
+
+        //called from process() - so from the shard's own task:
+        void setNearestNodeHandler(NearestNodeHandler nearestNodeHandler);
+
+        //from one receiving task - queues each observation on its shard, returns the number queued:
+        //
+        //Each observation's time is moved onto the collector's clock - the batch's time of receipt, less the observation's age
+        //when it was sent. So freshness and order are judged by one clock, whatever the nodes' own.
+        int ingest(const uint8_t *batch, int lengthBytes);
+        int ingest(const uint8_t *batch, int lengthBytes, uint64_t receivedAtMs);
+
+        //from one task per shard - applies the queued observations, returns the number applied:
+        int process(int shardIndex);
+
+        //only consistent while the shard is not being processed:
+        bool getDeviceState(eth_addr &macAddress, DeviceState &state);
+        bool getDeviceState(uint64_t macAddressKey, DeviceState &state);
+        int getDeviceCount();
+
+        uint32_t getIngestedObservationCount();
+        uint32_t getDroppedObservationCount();
+        uint32_t getLostBatchCount();
+        uint32_t getEvictedDeviceCount();
+
+    private:
+        Collector(Collector const&);
+        void operator=(Collector const&);
+
+        //a single producer, single consumer queue - ingest() only moves the head, process() only the tail:
+        typedef struct {
+            Observation queue[shardQueueLength];
+            uint32_t head;
+            uint32_t tail;
+
+            //open addressing - slots are replaced but never emptied, so probe sequences stay intact:
+            DeviceState devices[maxDevicesPerShard];
+            int deviceCount;
+            uint32_t evictedDeviceCount;
+        } Shard;
+
+        static const int maxProbes = 16;
+
+        Shard shards[maxShards];
+        int shardCount = 1;
+
+        Clock clock;
+
+        uint16_t nodeIds[maxNodes];
+        uint16_t nextSequences[maxNodes];
+        int nodeCount = 0;
+        void checkSequence(uint16_t nodeId, uint16_t sequence);
+
+        uint32_t ingestedObservationCount = 0;
+        uint32_t droppedObservationCount = 0;
+        uint32_t lostBatchCount = 0;
+
+        static int getSlot(uint64_t macAddressKey);
+        void update(Shard &shard, Observation &observation);
+
+        typedef struct {
+            uint16_t nodeId;
+            float x;
+            float y;
+        } NodePosition;
+        NodePosition nodePositions[maxNodes];
+        int nodePositionCount = 0;
+        NodePosition *getNodePosition(uint16_t nodeId);
+
+        PositionMethod positionMethod = NONE;
+        int rssiAtOneMetre = -45;
+        float pathLossExponent = 2.5;
+        int fusionWindowMs = 5000;
+        int nearestNodeMarginDb = 3;
+        NearestNodeHandler nearestNodeHandler = NULL;
+
+        void fuse(DeviceState &state, Observation &observation);
+        void updateNearestNode(DeviceState &state, uint32_t nowMs);
+        void updatePosition(DeviceState &state, uint32_t nowMs);
+        float getDistance(int rssi);
+        bool isFresh(Reading &reading, uint32_t nowMs);     //used and within the fusion window
+};
+
+#endif
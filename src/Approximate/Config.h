@@ -0,0 +1,121 @@
+/*
+    Config.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Config_h
+#define Config_h
+
+//Each of these may be overridden with a build flag, for example: -DAPPROXIMATE_MAX_DEVICES=16
+
+//Table sizes - all storage is allocated statically:
+#ifndef APPROXIMATE_MAX_DEVICES
+  #define APPROXIMATE_MAX_DEVICES 64
+#endif
+
+#ifndef APPROXIMATE_MAX_FILTERS
+  #define APPROXIMATE_MAX_FILTERS 16
+#endif
+
+#ifndef APPROXIMATE_MAX_CONTINUATIONS
+  #define APPROXIMATE_MAX_CONTINUATIONS 8
+#endif
+
+//The bytes of RSSI history held by each device - a sample a second usually takes one:
+#ifndef APPROXIMATE_RSSI_HISTORY_BYTES
+  #define APPROXIMATE_RSSI_HISTORY_BYTES 32
+#endif
+
+//The observations a Reporter holds until they can be sent - a power of two:
+#ifndef APPROXIMATE_REPORTER_QUEUE_LENGTH
+  #define APPROXIMATE_REPORTER_QUEUE_LENGTH 256
+#endif
+
+//Collector sizes - the devices and queue are per shard, and each a power of two - an ESP32 has a shard for each core:
+#ifndef APPROXIMATE_COLLECTOR_MAX_SHARDS
+  #if defined(ESP32)
+    #define APPROXIMATE_COLLECTOR_MAX_SHARDS 2
+  #else
+    #define APPROXIMATE_COLLECTOR_MAX_SHARDS 1
+  #endif
+#endif
+
+#ifndef APPROXIMATE_COLLECTOR_MAX_DEVICES
+  #if defined(ESP32)
+    #define APPROXIMATE_COLLECTOR_MAX_DEVICES 256
+  #else
+    #define APPROXIMATE_COLLECTOR_MAX_DEVICES 64
+  #endif
+#endif
+
+#ifndef APPROXIMATE_COLLECTOR_QUEUE_LENGTH
+  #if defined(ESP32)
+    #define APPROXIMATE_COLLECTOR_QUEUE_LENGTH 256
+  #else
+    #define APPROXIMATE_COLLECTOR_QUEUE_LENGTH 64
+  #endif
+#endif
+
+//The memory taken by each OccupancyCounter:
+#ifndef APPROXIMATE_OCCUPANCY_BUDGET_BYTES
+  #define APPROXIMATE_OCCUPANCY_BUDGET_BYTES 2048
+#endif
+
+//The memory taken by the sketches of a TrafficCounter, and the number of heaviest devices it holds:
+#ifndef APPROXIMATE_TRAFFIC_BUDGET_BYTES
+  #define APPROXIMATE_TRAFFIC_BUDGET_BYTES 4096
+#endif
+
+#ifndef APPROXIMATE_TRAFFIC_TOP_N
+  #define APPROXIMATE_TRAFFIC_TOP_N 8
+#endif
+
+//Subsystems - disabled subsystems are not compiled:
+#ifndef APPROXIMATE_CSI_ENABLED
+  #if defined(ESP32)
+    #define APPROXIMATE_CSI_ENABLED 1
+  #else
+    #define APPROXIMATE_CSI_ENABLED 0
+  #endif
+#endif
+
+#ifndef APPROXIMATE_ARP_ENABLED
+  #define APPROXIMATE_ARP_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_STRING_API_ENABLED
+  #define APPROXIMATE_STRING_API_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_RSSI_HISTORY_ENABLED
+  #define APPROXIMATE_RSSI_HISTORY_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_REPORTER_ENABLED
+  #define APPROXIMATE_REPORTER_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_COLLECTOR_ENABLED
+  #define APPROXIMATE_COLLECTOR_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_OCCUPANCY_ENABLED
+  #define APPROXIMATE_OCCUPANCY_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+  #define APPROXIMATE_TRAFFIC_COUNTER_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_ALLOWLIST_ENABLED
+  #define APPROXIMATE_ALLOWLIST_ENABLED 1
+#endif
+
+#ifndef APPROXIMATE_TRAFFIC_GENERATOR_ENABLED
+  #define APPROXIMATE_TRAFFIC_GENERATOR_ENABLED 1
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+    Continuation.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Continuation.h"
+
+Continuation::Continuation() {
+}
+
+Continuation::~Continuation() {
+    clear();
+}
+
+void Continuation::init(wl_status_t status, uint32_t sequence, voidFnPtr callBackFnPtr) {
+    clear();
+    this -> status = status;
+    this -> sequence = sequence;
+    this -> callBackFnPtr = callBackFnPtr;
+
+    invoker = [](voidFnPtr callBackFnPtr, void *) {
+        callBackFnPtr();
+    };
+}
+
+void Continuation::invoke() {
+    if(invoker && callBackFnPtr) invoker(callBackFnPtr, payload);
+    clear();
+}
+
+void Continuation::clear() {
+    if(destroyer) destroyer(payload);
+
+    status = WL_IDLE_STATUS;
+    callBackFnPtr = NULL;
+    invoker = NULL;
+    destroyer = NULL;
+}
+
+bool Continuation::isPending() {
+    return(callBackFnPtr != NULL);
+}
+
+bool Continuation::isPending(wl_status_t status) {
+    return(isPending() && this -> status == status);
+}
+
+uint32_t Continuation::getSequence() {
+    return(sequence);
+}
@@ -0,0 +1,75 @@
+/*
+    Continuation.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Continuation_h
+#define Continuation_h
+
+#include <Arduino.h>
+#include <new>
+
+#if defined(ESP8266)
+    #include <ESP8266WiFi.h>        //https://github.com/esp8266/Arduino
+
+#elif defined(ESP32)
+    #include <WiFi.h>               //https://github.com/espressif/arduino-esp32/
+
+#endif
+
+//A callback and its payload, held without allocation until the WiFi reaches a given status:
+class Continuation {
+    public:
+        typedef void (*voidFnPtr)();
+
+        //large enough for the largest payload, a String:
+        static const size_t maxPayloadSize = sizeof(String);
+
+        Continuation();
+        ~Continuation();
+
+        void init(wl_status_t status, uint32_t sequence, voidFnPtr callBackFnPtr);
+
+        template<typename Payload>
+        void init(wl_status_t status, uint32_t sequence, void (*callBackFnPtr)(Payload), const Payload &payload) {
+            static_assert(sizeof(Payload) <= maxPayloadSize, "Continuation payload too large");
+
+            clear();
+            this -> status = status;
+            this -> sequence = sequence;
+            this -> callBackFnPtr = (voidFnPtr) callBackFnPtr;
+
+            new (this -> payload) Payload(payload);
+            invoker = [](voidFnPtr callBackFnPtr, void *payload) {
+                ((void (*)(Payload)) callBackFnPtr)(*((Payload *) payload));
+            };
+            destroyer = [](void *payload) {
+                ((Payload *) payload) -> ~Payload();
+            };
+        }
+
+        void invoke();
+        void clear();
+
+        bool isPending();
+        bool isPending(wl_status_t status);
+        uint32_t getSequence();
+
+    private:
+        Continuation(Continuation const&);
+        void operator=(Continuation const&);
+
+        wl_status_t status = WL_IDLE_STATUS;
+        uint32_t sequence = 0;
+
+        voidFnPtr callBackFnPtr = NULL;
+        void (*invoker)(voidFnPtr callBackFnPtr, void *payload) = NULL;
+        void (*destroyer)(void *payload) = NULL;
+
+        alignas(8) uint8_t payload[maxPayloadSize];
+};
+
+#endif
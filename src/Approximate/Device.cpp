@@ -9,15 +9,52 @@
 #include "Device.h"
 #include "Approximate.h"
 
+static_assert(sizeof(DeviceRecord) == 16, "DeviceRecord should pack into 16 bytes");
+
+BssidTable Device::sharedBssidTable;
+
+int BssidTable::getIndex(eth_addr &bssid, int channel) {
+    int index = 0;
+
+    uint64_t bssidKey = eth_addr_to_uint64(&bssid) | ((uint64_t) (channel > 0 && channel <= 0xFF ? channel : 0) << 48);
+    for(int n = 1; n < bssidCount && index == 0; ++n) {
+        if(bssidTable[n] == bssidKey) index = n;
+    }
+
+    //once the table is full further BSSIDs are unknown:
+    if(index == 0 && bssidKey != 0 && bssidCount < maxBssids) {
+        index = bssidCount++;
+        bssidTable[index] = bssidKey;
+    }
+
+    return(index);
+}
+
+void BssidTable::getBssid(int index, eth_addr &bssid) {
+    uint64_to_eth_addr(bssidTable[index] & 0xFFFFFFFFFFFFULL, &bssid);
+}
+
+int BssidTable::getChannel(int index) {
+    int channel = (int) (bssidTable[index] >> 48);
+
+    return(channel > 0 ? channel : -1);
+}
+
 Device::Device() {
-    ipAddress.addr = IPADDR_ANY;
 }
 
+Device::Device(BssidTable *bssidTable, DeviceState *state) {
+    this -> bssidTable = bssidTable;
+    this -> state = state;
+}
+
+//a copy of the record only - the state stays with the table it came from, whose slot may later hold another device:
 Device::Device(Device *b) {
-    init(b -> macAddress, b -> bssid, b -> channel, b -> rssi, b -> lastSeenAtMs, b -> dataFlowBytes, b -> ipAddress.addr);
+    record = b -> record;
+    bssidTable = b -> bssidTable;
 }
 
-Device::Device(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, long lastSeenAtMs, int dataFlowBytes, u32_t ipAddress) {
+Device::Device(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, uint64_t lastSeenAtMs, int dataFlowBytes, u32_t ipAddress) {
     init(macAddress, bssid, channel, rssi, lastSeenAtMs, dataFlowBytes, ipAddress);
 }
 
@@ -27,18 +64,17 @@ bool Device::operator ==(Device *b) {
 }
 
 bool Device::operator ==(Device const& b) {
-    return(eth_addr_cmp(&this -> macAddress, &b.macAddress));
+    return(record.macAddress == b.record.macAddress);
 }
 
 bool Device::operator ==(eth_addr &macAddress) {
     return(matches(macAddress));
 }
 
-void Device::init(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, long lastSeenAtMs, int dataFlowBytes, u32_t ipAddress) {
+void Device::init(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, uint64_t lastSeenAtMs, int dataFlowBytes, u32_t ipAddress) {
     setMacAddress(macAddress);
-    setBssid(bssid);
-    
-    setChannel(channel);
+    record.bssidIndex = bssidTable -> getIndex(bssid, channel);
+
     setRSSI(rssi);
     setLastSeenAtMs(lastSeenAtMs);
     setDataFlowBytes(dataFlowBytes);
@@ -47,47 +83,151 @@ void Device::init(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi,
 }
 
 void Device::update(Device *d) {
-    if(d) init(d -> macAddress, d -> bssid, d -> channel, d -> rssi, d -> lastSeenAtMs, d -> dataFlowBytes, d -> ipAddress.addr);
+    if(d) {
+        record = d -> record;
+        updateActivity(d);
+        smoothRSSI(record.rssi);
+    }
+}
+
+void Device::updateActivity(Device *d) {
+    if(d) {
+        record.lastSeenAtMs = d -> record.lastSeenAtMs;
+        if(state && d -> state) {
+            state -> dataFlowBytes = d -> state -> dataFlowBytes;
+            state -> known = d -> state -> known;
+        }
+    }
+}
+
+void Device::copy(Device *d) {
+    if(d) {
+        record = d -> record;
+        if(state) {
+            DeviceState empty = {};
+            *state = d -> state ? *(d -> state) : empty;
+
+            #if APPROXIMATE_RSSI_HISTORY_ENABLED
+                //each device starts its own history:
+                state -> rssiHistory.clear();
+            #endif
+        }
+    }
 }
 
 void Device::getMacAddress(eth_addr &macAddress) {
-    ETHADDR16_COPY(&macAddress, &this -> macAddress);
+    uint64_to_eth_addr(record.macAddress, &macAddress);
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 String Device::getMacAddressAsString() {
     String macAddressAsString = "";
 
+    eth_addr macAddress;
+    getMacAddress(macAddress);
     Approximate::eth_addr_to_String(macAddress, macAddressAsString);
 
     return(macAddressAsString);
 }
+#endif
 
 char *Device::getMacAddressAs_c_str(char *out) {
+    eth_addr macAddress;
+    getMacAddress(macAddress);
     Approximate::eth_addr_to_c_str(macAddress, out);
     
     return(out);
 }
 
 void Device::setMacAddress(eth_addr &macAddress) {
-    ETHADDR16_COPY(&this -> macAddress, &macAddress);
+    record.macAddress = eth_addr_to_uint64(&macAddress);
+}
+
+uint64_t Device::getMacAddressKey() {
+    return(record.macAddress);
+}
+
+void Device::getBssid(eth_addr &bssid) {
+    bssidTable -> getBssid(record.bssidIndex, bssid);
+}
+
+#if APPROXIMATE_STRING_API_ENABLED
+String Device::getBssidAsString() {
+    String bssidAsString = "";
+
+    eth_addr bssid;
+    getBssid(bssid);
+    Approximate::eth_addr_to_String(bssid, bssidAsString);
+
+    return(bssidAsString);
+}
+#endif
+
+char *Device::getBssidAs_c_str(char *out) {
+    eth_addr bssid;
+    getBssid(bssid);
+    Approximate::eth_addr_to_c_str(bssid, out);
+
+    return(out);
+}
+
+void Device::setBssid(eth_addr &bssid) {
+    record.bssidIndex = bssidTable -> getIndex(bssid, getChannel());
+}
+
+int Device::getShardIndex(uint64_t macAddressKey, int shardCount) {
+    //fold the OUI into the device bytes, so that both count:
+    uint32_t hash = (uint32_t) (macAddressKey ^ (macAddressKey >> 24));
+
+    return(shardCount > 1 ? (int) (hash % shardCount) : 0);
+}
+
+uint64_t Device::getMacAddressHash(uint64_t macAddressKey) {
+    //the splitmix64 finaliser - so that sequential addresses spread evenly:
+    uint64_t hash = macAddressKey;
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+
+    return(hash);
+}
+
+int Device::getChannel() {
+    return(bssidTable -> getChannel(record.bssidIndex));
+}
+
+void Device::setChannel(int channel) {
+    eth_addr bssid;
+    getBssid(bssid);
+    record.bssidIndex = bssidTable -> getIndex(bssid, channel);
 }
 
 void Device::getIPAddress(ip4_addr_t &ipAddress) {
-    ipAddress.addr = this -> ipAddress.addr;
+    ipAddress.addr = record.ipAddress;
 }
 
+#if APPROXIMATE_STRING_API_ENABLED
 String Device::getIPAddressAsString() {
     String ipAddressAsString;
     ipAddressAsString.reserve(16);
 
+    ip4_addr_t ipAddress;
+    getIPAddress(ipAddress);
+
     if(ipAddress.addr != IPADDR_ANY) {
         ipAddressAsString = String(ip4addr_ntoa(&ipAddress));
     }
 
     return(ipAddressAsString);
 }
+#endif
 
 char *Device::getIPAddressAs_c_str(char *out) {
+    ip4_addr_t ipAddress;
+    getIPAddress(ipAddress);
+
     if(ipAddress.addr != IPADDR_ANY) {
         strcpy(out, ip4addr_ntoa(&ipAddress));
     }
@@ -100,52 +240,97 @@ void Device::setIPAddress(ip4_addr_t &ipAddress) {
 }
 
 void Device::setIPAddress(u32_t ipAddress) {
-    this -> ipAddress.addr = ipAddress;
+    record.ipAddress = ipAddress;
 }
 
 bool Device::hasIPAddress() {
-    return(ipAddress.addr != IPADDR_ANY);
+    return(record.ipAddress != IPADDR_ANY);
 }
 
 void Device::setRSSI(int rssi) {
-    this -> rssi = rssi;
+    record.rssi = constrain(rssi, -128, 127);
+    smoothRSSI(record.rssi);
 }
 
 int Device::getRSSI() {
-    return(rssi);
+    return(record.rssi);
+}
+
+int Device::getSmoothedRSSI() {
+    //rounded to the nearest dBm, or the last reading without a state:
+    int smoothedRSSI = state ? state -> smoothedRSSI : record.rssi * 16;
+
+    return((smoothedRSSI + (smoothedRSSI < 0 ? -8 : 8)) / 16);
+}
+
+#if APPROXIMATE_RSSI_HISTORY_ENABLED
+RSSIHistory *Device::getRSSIHistory() {
+    return(state ? &(state -> rssiHistory) : NULL);
 }
+#endif
 
-void Device::setLastSeenAtMs(long lastSeenAtMs) {
-    if(lastSeenAtMs == -1) lastSeenAtMs = millis(); 
-    this -> lastSeenAtMs = lastSeenAtMs;
+void Device::setZone(int zone) {
+    if(state) state -> zone = zone;
 }
 
-int Device::getLastSeenAtMs() {
-    return(lastSeenAtMs);
+int Device::getZone() {
+    return(state ? state -> zone : 0);
+}
+
+void Device::setKnown(bool known) {
+    if(state) state -> known = known;
+}
+
+bool Device::isKnown() {
+    return(state ? state -> known : false);
+}
+
+void Device::smoothRSSI(int rssi) {
+    //an exponential moving average, weighting each new reading by a quarter:
+    if(state && rssi != APPROXIMATE_UNKNOWN_RSSI) {
+        int16_t &smoothedRSSI = state -> smoothedRSSI;
+
+        if(smoothedRSSI == 0)   smoothedRSSI = rssi * 16;
+        else                    smoothedRSSI += ((rssi * 16) - smoothedRSSI) / 4;
+
+        if(smoothedRSSI == 0) smoothedRSSI = -1;
+    }
+}
+
+void Device::setLastSeenAtMs(uint64_t lastSeenAtMs) {
+    record.lastSeenAtMs = (uint32_t) lastSeenAtMs;
+}
+
+uint32_t Device::getLastSeenAtMs() {
+    return(record.lastSeenAtMs);
+}
+
+uint32_t Device::getLastSeenAgeMs(uint64_t nowMs) {
+    return((uint32_t) nowMs - record.lastSeenAtMs);
 }
 
 bool Device::matches(eth_addr &macAddress) {
-    return(eth_addr_cmp(&this -> macAddress, &macAddress));
+    return(matches(eth_addr_to_uint64(&macAddress)));
 }
 
-uint32_t Device::getOUI() {
-    uint32_t oui = 0;
-    
-    oui = (macAddress.addr[0] << 16) | (macAddress.addr[1] << 8) | (macAddress.addr[2] & 0xFF);
+bool Device::matches(uint64_t macAddressKey) {
+    return(record.macAddress == macAddressKey);
+}
 
-    return(oui);
+uint32_t Device::getOUI() {
+    return((record.macAddress >> 24) & 0xFFFFFF);
 }
 
 void Device::setDataFlowBytes(int dataFlowBytes) {
-    this -> dataFlowBytes = dataFlowBytes;
+    if(state) state -> dataFlowBytes = constrain(dataFlowBytes, -32768, 32767);
 }
 
 bool Device::isUploading() {
-    return(dataFlowBytes < 0);
+    return(state && state -> dataFlowBytes < 0);
 }
 
 bool Device::isDownloading() {
-    return(dataFlowBytes > 0);
+    return(state && state -> dataFlowBytes > 0);
 }
 
 int Device::getDownloadSizeBytes() {
@@ -161,7 +346,76 @@ int Device::getUploadSizeBytes() {
 }
 
 int Device::getPayloadSizeBytes(){
-    return(abs(dataFlowBytes));
+    return(state ? abs(state -> dataFlowBytes) : 0);
+}
+
+bool Device::updateSequence(uint16_t sequenceControl, bool retry, bool uplink) {
+    bool isDuplicate = false;
+
+    if(state) {
+        bool &hasLastSequenceControl = uplink ? state -> hasUplinkSequenceControl : state -> hasDownlinkSequenceControl;
+        uint16_t &lastSequenceControl = uplink ? state -> lastUplinkSequenceControl : state -> lastDownlinkSequenceControl;
+
+        //a retried frame with the same sequence control as the last is a duplicate:
+        isDuplicate = retry && hasLastSequenceControl && (lastSequenceControl == sequenceControl);
+
+        if(uplink) {
+            //only frames sent by the device carry its own sequence numbers:
+            state -> uplinkFrameCount++;
+            if(retry) state -> uplinkRetryCount++;
+
+            if(!isDuplicate && hasLastSequenceControl) {
+                int gap = ((sequenceControl >> 4) - (lastSequenceControl >> 4)) & 0xFFF;
+                if(gap > 1 && gap < maxSequenceGap) state -> uplinkLostFrameCount += gap - 1;
+            }
+        }
+
+        if(!isDuplicate) {
+            lastSequenceControl = sequenceControl;
+            hasLastSequenceControl = true;
+        }
+    }
+
+    return(!isDuplicate);
+}
+
+int Device::getLastSequenceNumber() {
+    return(state && state -> hasUplinkSequenceControl ? (state -> lastUplinkSequenceControl >> 4) : -1);
+}
+
+bool Device::isSequenceContinuous(Device *d) {
+    bool result = false;
+
+    //only sequence numbers seen on both sides are evidence of the same device:
+    if(d && getLastSequenceNumber() >= 0 && d -> getLastSequenceNumber() >= 0) {
+        int gap = (d -> getLastSequenceNumber() - getLastSequenceNumber()) & 0xFFF;
+        result = (gap > 0 && gap < maxSequenceGap);
+    }
+
+    return(result);
+}
+
+void Device::continueSequence(Device *d) {
+    //the frames that linked the new address are counted as this device's:
+    if(state && d && d -> state) {
+        state -> hasUplinkSequenceControl = d -> state -> hasUplinkSequenceControl;
+        state -> hasDownlinkSequenceControl = d -> state -> hasDownlinkSequenceControl;
+        state -> lastUplinkSequenceControl = d -> state -> lastUplinkSequenceControl;
+        state -> lastDownlinkSequenceControl = d -> state -> lastDownlinkSequenceControl;
+        state -> uplinkFrameCount += d -> state -> uplinkFrameCount;
+        state -> uplinkRetryCount += d -> state -> uplinkRetryCount;
+        state -> uplinkLostFrameCount += d -> state -> uplinkLostFrameCount;
+    }
+}
+
+float Device::getRetryRate() {
+    return(state && state -> uplinkFrameCount > 0 ? (float) state -> uplinkRetryCount / state -> uplinkFrameCount : 0.0);
+}
+
+float Device::getFrameLossRate() {
+    uint32_t expectedFrameCount = state ? state -> uplinkFrameCount + state -> uplinkLostFrameCount : 0;
+
+    return(expectedFrameCount > 0 ? (float) state -> uplinkLostFrameCount / expectedFrameCount : 0.0);
 }
 
 bool Device::isUniversal() {
@@ -175,9 +429,9 @@ bool Device::isIndividual() {
 //Universal/local and individual/group defined by: https://standards.ieee.org/content/dam/ieee-standards/standards/web/documents/tutorials/macgrp.pdf
 
 bool Device::isLocal() {
-    return((macAddress.addr[0] & 0x2 == 0x2) && !isGroup());
+    return(((record.macAddress >> 40) & 0x2) == 0x2 && !isGroup());
 }
 
 bool Device::isGroup() {
-    return(macAddress.addr[0] & 0x1 == 0x1);
+    return(((record.macAddress >> 40) & 0x1) == 0x1);
 }
\ No newline at end of file
@@ -10,39 +10,119 @@
 #define Device_h
 
 #include <Arduino.h>
-#include "Channel.h"
+#include "Config.h"
 #include "eth_addr.h"
+#include "RSSIHistory.h"
 
 #define APPROXIMATE_UNKNOWN_RSSI 0
 
-class Device : public Channel {
+//The observed state of a device packed into 16 bytes - the MAC address is held as a 48-bit integer key:
+typedef struct {
+    uint64_t macAddress : 48;
+    int64_t rssi : 8;
+    uint64_t bssidIndex : 8;    //into a BssidTable, which also holds the channel - 0 if unknown
+    uint32_t lastSeenAtMs;      //low 32 bits of the clock - ages are taken by unsigned difference, so survive a wrap
+    u32_t ipAddress;
+} __attribute__((packed)) DeviceRecord;
+
+//The BSSIDs seen by one instance of Approximate, each with the channel it was heard on - so a record holds only an index:
+class BssidTable {
     private:
-        eth_addr macAddress = {{0,0,0,0,0,0}};
-        ip4_addr_t ipAddress;
-        int rssi = APPROXIMATE_UNKNOWN_RSSI;
-        long lastSeenAtMs = -1;
-        int dataFlowBytes = 0;  //uploading is negative, downloading positive
+        static const int maxBssids = 32;
+        uint64_t bssidTable[maxBssids] = {0};   //the BSSID in the low 48 bits, the channel above
+        int bssidCount = 1;                     //index 0 is reserved for unknown
 
     public:
+        //adds the BSSID and channel if not already there - 0 if both are unknown or the table is full:
+        int getIndex(eth_addr &bssid, int channel);
+
+        void getBssid(int index, eth_addr &bssid);
+        int getChannel(int index);
+};
+
+//What Approximate keeps for each proximate device beside its record - in a side table, so that the records stay small:
+typedef struct {
+    int16_t dataFlowBytes;      //uploading is negative, downloading positive
+    int16_t smoothedRSSI;       //in 1/16 dBm, 0 if unknown
+    uint8_t zone;               //as classified by Approximate, 0 if none
+    bool known;                 //in Approximate's allowlist
+
+    //sequence control of the last frame sent by and to this device:
+    bool hasUplinkSequenceControl;
+    bool hasDownlinkSequenceControl;
+    uint16_t lastUplinkSequenceControl;
+    uint16_t lastDownlinkSequenceControl;
+    uint32_t uplinkFrameCount;
+    uint32_t uplinkRetryCount;
+    uint32_t uplinkLostFrameCount;
+
+    #if APPROXIMATE_RSSI_HISTORY_ENABLED
+      RSSIHistory rssiHistory;
+    #endif
+} DeviceState;
+
+//A device record, with the BSSID table it indexes and its state - a device without a state keeps only its record:
+class Device {
+    private:
+        DeviceRecord record = {0, APPROXIMATE_UNKNOWN_RSSI, 0, 0, IPADDR_ANY};
+        BssidTable *bssidTable = &sharedBssidTable;
+        DeviceState *state = NULL;
+        void smoothRSSI(int rssi);
+
+        //for devices made outside of Approximate:
+        static BssidTable sharedBssidTable;
+
+        static const int maxSequenceGap = 64;   //larger gaps are taken as a reset or another traffic class
+
+    public:
+        //devices are spread over shards by a hash of their address - the same on every node:
+        static int getShardIndex(uint64_t macAddressKey, int shardCount);
+
+        //a 64-bit hash of the address, for the sketches and filters that sample it:
+        static uint64_t getMacAddressHash(uint64_t macAddressKey);
+
         Device();
+        Device(BssidTable *bssidTable, DeviceState *state);
+
+        //an independent copy, safe to keep after the device departs - of its record (address, BSSID, channel, RSSI, last seen and IP address)
+        //but not its state, so data flow, zone, smoothed RSSI, sequence counts and history read as unknown:
         Device(Device *b);
-        Device(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi = APPROXIMATE_UNKNOWN_RSSI, long lastSeenAtMs = -1, int bytesFlow = 0, u32_t ipAddress = IPADDR_ANY);
+        Device(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi = APPROXIMATE_UNKNOWN_RSSI, uint64_t lastSeenAtMs = 0, int bytesFlow = 0, u32_t ipAddress = IPADDR_ANY);
 
         //TODO: tidy-up these operators and matches()
         bool operator ==(Device *b);
         bool operator ==(Device const& b);
         bool operator ==(eth_addr &macAddress);
 
-        void init(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, long lastSeenAtMs, int bytesFlow, u32_t ipAddress = IPADDR_ANY);
+        void init(eth_addr &macAddress, eth_addr &bssid, int channel, int rssi, uint64_t lastSeenAtMs, int bytesFlow, u32_t ipAddress = IPADDR_ANY);
         void update(Device *d);
 
+        //from a frame sent to the device, whose RSSI is not its own - the time and data flow, but not the RSSI or BSSID:
+        void updateActivity(Device *d);
+        void copy(Device *d);
+
         void getMacAddress(eth_addr &macAddress);
+        #if APPROXIMATE_STRING_API_ENABLED
         String getMacAddressAsString();
+        #endif
         char *getMacAddressAs_c_str(char *out);
         void setMacAddress(eth_addr &macAddress);
+        uint64_t getMacAddressKey();
+
+        void getBssid(eth_addr &bssid);
+        #if APPROXIMATE_STRING_API_ENABLED
+        String getBssidAsString();
+        #endif
+        char *getBssidAs_c_str(char *out);
+        void setBssid(eth_addr &bssid);
+
+        int getChannel();
+        void setChannel(int channel);
 
         void getIPAddress(ip4_addr_t &ipAddress);
+        #if APPROXIMATE_STRING_API_ENABLED
         String getIPAddressAsString();
+        #endif
         char *getIPAddressAs_c_str(char *out);
         void setIPAddress(ip4_addr_t &ipAddress);
         void setIPAddress(u32_t ipAddress);
@@ -50,11 +130,23 @@ class Device : public Channel {
 
         void setRSSI(int rssi);
         int getRSSI();
+        int getSmoothedRSSI();
+        #if APPROXIMATE_RSSI_HISTORY_ENABLED
+            RSSIHistory *getRSSIHistory();
+        #endif
+
+        void setZone(int zone);
+        int getZone();
 
-        void setLastSeenAtMs(long lastSeenAtMs = -1);
-        int getLastSeenAtMs();
+        void setKnown(bool known);
+        bool isKnown();
+
+        void setLastSeenAtMs(uint64_t lastSeenAtMs);
+        uint32_t getLastSeenAtMs();
+        uint32_t getLastSeenAgeMs(uint64_t nowMs);
 
         bool matches(eth_addr &macAddress);
+        bool matches(uint64_t macAddressKey);
 
         uint32_t getOUI();
 
@@ -67,6 +159,13 @@ class Device : public Channel {
         int getDownloadSizeBytes();
         int getPayloadSizeBytes();
 
+        bool updateSequence(uint16_t sequenceControl, bool retry, bool uplink);
+        int getLastSequenceNumber();
+        bool isSequenceContinuous(Device *d);
+        void continueSequence(Device *d);
+        float getRetryRate();
+        float getFrameLossRate();
+
         bool isUniversal();
         bool isLocal();
         bool isIndividual();
@@ -11,28 +11,36 @@
 eth_addr Filter::NONE = eth_addr({{0xff,0xff,0xff,0xff,0xff,0xff}});
 eth_addr Filter::ANY = eth_addr({{0x00,0x00,0x00,0x00,0x00,0x00}});
 
+Filter::Filter() {
+    ETHADDR16_COPY(&this -> macAddress, &ANY);
+    macAddressKey = 0;
+}
+
 Filter::Filter(eth_addr &macAddress, Direction direction) {
     ETHADDR16_COPY(&this -> macAddress, &macAddress);
+    macAddressKey = eth_addr_to_uint64(&macAddress);
     
     this -> direction = direction;
 }
 
 bool Filter::matches(eth_addr *macAddress) {
+    return(matches(eth_addr_to_uint64(macAddress)));
+}
+
+bool Filter::matches(uint64_t macAddressKey) {
     bool result = true;
 
-    if(eth_addr_cmp(macAddress, &ANY)) {
+    if(macAddressKey == eth_addr_to_uint64(&ANY)) {
         result = true;
     }
-    else if(eth_addr_cmp(macAddress, &NONE)) {
+    else if(macAddressKey == eth_addr_to_uint64(&NONE)) {
         result = false;
     }
     else {
         //if an OUI only match on first 3 bytes:
-        int N = isOUIFilter() ? 3 : 6;
+        int shift = isOUIFilter() ? 24 : 0;
 
-        for(int n=0; n<N && result; ++n) {
-            result = (this -> macAddress.addr[n] == macAddress -> addr[n]);
-        }
+        result = (this -> macAddressKey >> shift) == (macAddressKey >> shift);
     }
 
     return(result);
@@ -42,10 +50,7 @@ bool Filter::matches(Device *device) {
     bool result = false;
 
     if(device) {
-        eth_addr macAddress;
-        device -> getMacAddress(macAddress);
-
-        if(matches(&macAddress)) {
+        if(matches(device -> getMacAddressKey())) {
             switch(direction) {
                 case EITHER:
                     result = true;  break;     
@@ -65,10 +70,7 @@ bool Filter::matches(Device *device) {
 }
 
 bool Filter::isOUIFilter() {
-    bool result = 
-        this -> macAddress.addr[3] == 0xFF && 
-        this -> macAddress.addr[4] == 0xFF &&
-        this -> macAddress.addr[5] == 0xFF;
+    bool result = (macAddressKey & 0xFFFFFF) == 0xFFFFFF;
 
     return(result);
 }
\ No newline at end of file
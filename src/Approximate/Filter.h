@@ -26,9 +26,15 @@ class Filter {
         eth_addr macAddress;
         Direction direction = Direction::NEITHER;
 
+    private:
+        uint64_t macAddressKey;
+        bool matches(uint64_t macAddressKey);
+
+    public:
         static eth_addr NONE;
         static eth_addr ANY;
 
+        Filter();
         Filter(eth_addr &macAddress, Direction direction = Direction::EITHER);
         bool matches(eth_addr *macAddress);
         bool matches(Device *device);
@@ -0,0 +1,72 @@
+/*
+    FixedList.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef FixedList_h
+#define FixedList_h
+
+//An ordered list of at most N items, with the same interface as ListLib's List:
+template<typename T, int N>
+class FixedList {
+    private:
+        T items[N];
+        int count = 0;
+
+    public:
+        bool Add(T item) {
+            bool success = (count < N);
+            if(success) items[count++] = item;
+            return(success);
+        }
+
+        void Remove(int index) {
+            if(index >= 0 && index < count) {
+                for(int n = index; n < count - 1; ++n) items[n] = items[n + 1];
+                count--;
+            }
+        }
+
+        int Count() { return(count); }
+        int Capacity() { return(N); }
+        bool IsEmpty() { return(count == 0); }
+        bool IsFull() { return(count == N); }
+
+        T &operator[](int index) { return(items[index]); }
+};
+
+//N statically allocated objects, handed out and returned in place of new and delete:
+template<typename T, int N>
+class FixedPool {
+    private:
+        T items[N];
+        bool allocated[N] = {false};
+
+    public:
+        T *allocate() {
+            T *item = NULL;
+            for(int n = 0; n < N && !item; ++n) {
+                if(!allocated[n]) {
+                    allocated[n] = true;
+                    item = &items[n];
+                }
+            }
+            return(item);
+        }
+
+        void release(T *item) {
+            int n = indexOf(item);
+            if(n >= 0) allocated[n] = false;
+        }
+
+        //so that side tables can be kept in step with the pool:
+        int indexOf(T *item) {
+            int n = item - items;
+            return((n >= 0 && n < N) ? n : -1);
+        }
+};
+
+#endif
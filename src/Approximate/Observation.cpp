@@ -0,0 +1,95 @@
+/*
+    Observation.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Observation.h"
+
+#if APPROXIMATE_REPORTER_ENABLED || APPROXIMATE_COLLECTOR_ENABLED
+
+static void write16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void write32(uint8_t *p, uint32_t v) {
+    for(int n = 0; n < 4; ++n) p[n] = v >> (8 * n);
+}
+
+static uint16_t read16(const uint8_t *p) {
+    return((uint16_t) (p[0] | (p[1] << 8)));
+}
+
+static uint32_t read32(const uint8_t *p) {
+    return((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+int ObservationBatch::getLengthBytes(int count) {
+    return(headerLengthBytes + (count * observationLengthBytes));
+}
+
+int ObservationBatch::encode(const Observation *observations, int count, uint16_t nodeId, uint16_t sequence, uint64_t sentAtMs, uint8_t *out, int outLengthBytes) {
+    int lengthBytes = 0;
+
+    if(observations && out && count > 0 && count <= maxObservations && getLengthBytes(count) <= outLengthBytes) {
+        write16(out, magic);
+        out[2] = version;
+        out[3] = count;
+        write16(out + 4, nodeId);
+        write16(out + 6, sequence);
+        write32(out + 8, (uint32_t) sentAtMs);
+        write32(out + 12, (uint32_t) (sentAtMs >> 32));
+
+        for(int n = 0; n < count; ++n) {
+            const Observation &observation = observations[n];
+            uint8_t *p = out + getLengthBytes(n);
+
+            //times are sent as ages when the batch was sent:
+            uint64_t ageMs = sentAtMs > observation.timeMs ? sentAtMs - observation.timeMs : 0;
+
+            for(int b = 0; b < 6; ++b) p[b] = observation.macAddress >> (8 * (5 - b));
+            p[6] = (uint8_t) observation.rssi;
+            p[7] = observation.channel;
+            write32(p + 8, ageMs < 0xFFFFFFFF ? (uint32_t) ageMs : 0xFFFFFFFF);
+        }
+
+        lengthBytes = getLengthBytes(count);
+    }
+
+    return(lengthBytes);
+}
+
+int ObservationBatch::decodeHeader(const uint8_t *in, int inLengthBytes, uint16_t &nodeId, uint16_t &sequence) {
+    int count = 0;
+
+    if(in && inLengthBytes >= headerLengthBytes && read16(in) == magic && in[2] == version) {
+        if(getLengthBytes(in[3]) <= inLengthBytes) {
+            count = in[3];
+            nodeId = read16(in + 4);
+            sequence = read16(in + 6);
+        }
+    }
+
+    return(count);
+}
+
+uint64_t ObservationBatch::decodeSentAtMs(const uint8_t *in) {
+    return(read32(in + 8) | ((uint64_t) read32(in + 12) << 32));
+}
+
+void ObservationBatch::decode(const uint8_t *in, int index, uint16_t nodeId, Observation &observation) {
+    uint64_t sentAtMs = decodeSentAtMs(in);
+    const uint8_t *p = in + getLengthBytes(index);
+
+    observation.macAddress = 0;
+    for(int b = 0; b < 6; ++b) observation.macAddress = (observation.macAddress << 8) | p[b];
+    observation.rssi = (int8_t) p[6];
+    observation.channel = p[7];
+    observation.timeMs = sentAtMs - read32(p + 8);
+    observation.nodeId = nodeId;
+}
+
+#endif
\ No newline at end of file
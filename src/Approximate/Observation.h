@@ -0,0 +1,47 @@
+/*
+    Observation.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Observation_h
+#define Observation_h
+
+#include <Arduino.h>
+#include "Config.h"
+
+//One sighting of a device by one node - what a Reporter sends and a Collector receives:
+typedef struct {
+    uint64_t macAddress;    //48-bit key, as Device::getMacAddressKey()
+    uint64_t timeMs;        //by the node's clock - and by the collector's, once ingested
+    uint16_t nodeId;
+    int8_t rssi;
+    uint8_t channel;
+} Observation;
+
+//Observations from one node are sent in batches - a 16 byte header, then 12 bytes for each, all little-endian:
+//
+//The header holds the time the batch was sent, and each observation its age then - both by the node's clock. So a collector can
+//place every observation on its own clock, by its time of receipt, without the nodes' clocks being synchronised.
+class ObservationBatch {
+    public:
+        static const uint16_t magic = 0x5841;   //"AX"
+        static const uint8_t version = 2;
+        static const int headerLengthBytes = 16;
+        static const int observationLengthBytes = 12;
+        static const int maxObservations = 100; //keeps a batch inside one unfragmented UDP datagram
+
+        static int getLengthBytes(int count);
+
+        //returns the number of bytes written, 0 if they don't fit:
+        static int encode(const Observation *observations, int count, uint16_t nodeId, uint16_t sequence, uint64_t sentAtMs, uint8_t *out, int outLengthBytes);
+
+        //returns the number of observations in the batch, 0 if it is not one:
+        static int decodeHeader(const uint8_t *in, int inLengthBytes, uint16_t &nodeId, uint16_t &sequence);
+        static uint64_t decodeSentAtMs(const uint8_t *in);
+        static void decode(const uint8_t *in, int index, uint16_t nodeId, Observation &observation);
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+    OccupancyCounter.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "OccupancyCounter.h"
+
+#if APPROXIMATE_OCCUPANCY_ENABLED
+
+//See: Flajolet et al., HyperLogLog: the analysis of a near-optimal cardinality estimation algorithm (2007)
+
+OccupancyCounter::OccupancyCounter() {
+    init();
+}
+
+void OccupancyCounter::init(float relativeError, uint32_t spanMs, uint32_t bucketMs) {
+    this -> bucketMs = max(bucketMs, (uint32_t) 1000);
+
+    //one more bucket than the span, as the newest is only partly filled:
+    bucketCount = constrain((int) ((spanMs + this -> bucketMs - 1) / this -> bucketMs) + 1, 2, maxBuckets);
+
+    //the standard error is 1.04 / sqrt(registers):
+    float relativeRegisters = 1.04 / max(relativeError, 0.01f);
+    float registersNeeded = relativeRegisters * relativeRegisters;
+    for(precision = 4; precision < 16 && (1 << precision) < registersNeeded; ++precision);
+    while(precision > 4 && ((1 << precision) * bucketCount) > budgetBytes) precision--;
+    registerCount = 1 << precision;
+
+    //a span too long for the budget is shortened:
+    bucketCount = min(bucketCount, budgetBytes / registerCount);
+
+    clear();
+}
+
+float OccupancyCounter::getRelativeError() {
+    return(1.04 / sqrt((float) registerCount));
+}
+
+void OccupancyCounter::setRSSIRange(int minRSSI, int maxRSSI) {
+    this -> minRSSI = minRSSI;
+    this -> maxRSSI = maxRSSI;
+}
+
+void OccupancyCounter::setChannel(int channel) {
+    this -> channel = channel;
+}
+
+void OccupancyCounter::clear() {
+    memset(registers, 0, sizeof(registers));
+    memset(bucketEpochs, 0, sizeof(bucketEpochs));
+}
+
+void OccupancyCounter::add(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs) {
+    if(rssi > minRSSI && rssi <= maxRSSI && (this -> channel == 0 || this -> channel == channel)) {
+        uint32_t epoch = (timeMs / bucketMs) + 1;
+        int bucket = epoch % bucketCount;
+
+        //too old to count once its bucket has been reused:
+        if(epoch >= bucketEpochs[bucket]) {
+            //the first bits choose a register, the run of zeros after is the rank:
+            uint64_t h = Device::getMacAddressHash(macAddressKey);
+            int index = h >> (64 - precision);
+            uint64_t rest = (h << precision) | (1ULL << (precision - 1));
+            uint8_t rank = __builtin_clzll(rest) + 1;
+
+            lock.beginWrite();
+
+            //the oldest bucket is reused once its time has passed:
+            if(bucketEpochs[bucket] != epoch) {
+                memset(&registers[bucket * registerCount], 0, registerCount);
+                bucketEpochs[bucket] = epoch;
+            }
+
+            uint8_t &r = registers[(bucket * registerCount) + index];
+            if(rank > r) r = rank;
+
+            lock.endWrite();
+        }
+    }
+}
+
+uint32_t OccupancyCounter::getCount(uint32_t windowMs, uint64_t nowMs) {
+    uint32_t nowEpoch = (nowMs / bucketMs) + 1;
+    int windowBuckets = (windowMs + bucketMs - 1) / bucketMs;
+
+    //the current bucket is only partly gone, so the start of the window lies in one more:
+    if((nowMs % bucketMs) != 0) windowBuckets++;
+    windowBuckets = constrain(windowBuckets, 1, bucketCount);
+
+    //merged by taking the largest of each register over the buckets in the window - again if add() wrote meanwhile:
+    float sum;
+    int zeroCount;
+    uint32_t sequence;
+    do {
+        sequence = lock.beginRead();
+
+        sum = 0;
+        zeroCount = 0;
+        for(int n = 0; n < registerCount; ++n) {
+            uint8_t r = 0;
+            for(int b = 0; b < bucketCount; ++b) {
+                if(bucketEpochs[b] > 0 && bucketEpochs[b] <= nowEpoch && (nowEpoch - bucketEpochs[b]) < (uint32_t) windowBuckets) {
+                    r = max(r, registers[(b * registerCount) + n]);
+                }
+            }
+            sum += ldexp(1.0, -r);
+            if(r == 0) zeroCount++;
+        }
+    } while(lock.retryRead(sequence));
+
+    float m = registerCount;
+    float alpha = registerCount == 16 ? 0.673 : registerCount == 32 ? 0.697 : registerCount == 64 ? 0.709 : 0.7213 / (1.0 + (1.079 / m));
+    float estimate = (alpha * m * m) / sum;
+
+    //small counts are better estimated from the empty registers:
+    if(estimate <= 2.5 * m && zeroCount > 0) estimate = m * log(m / zeroCount);
+
+    return((uint32_t) (estimate + 0.5));
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+    OccupancyCounter.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef OccupancyCounter_h
+#define OccupancyCounter_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Device.h"
+#include "SequenceLock.h"
+
+//Estimates the number of distinct devices seen over a recent window, in fixed memory - a HyperLogLog for each time bucket:
+class OccupancyCounter {
+    public:
+        static const int budgetBytes = APPROXIMATE_OCCUPANCY_BUDGET_BYTES;
+
+        OccupancyCounter();
+
+        //the precision is the highest the budget allows for the span, up to the error asked for:
+        void init(float relativeError = 0.1, uint32_t spanMs = 3600000, uint32_t bucketMs = 300000);
+        float getRelativeError();
+
+        //only count devices heard within this RSSI range (a zone) or on this channel - by default all:
+        void setRSSIRange(int minRSSI, int maxRSSI);
+        void setChannel(int channel);
+
+        void add(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs);
+
+        //distinct devices within the window, rounded out to whole buckets so that none in it are missed - at most the span:
+        uint32_t getCount(uint32_t windowMs, uint64_t nowMs);
+        void clear();
+
+    private:
+        OccupancyCounter(OccupancyCounter const&);
+        void operator=(OccupancyCounter const&);
+
+        //written by add() on the WiFi task, read from loop():
+        SequenceLock lock;
+
+        uint8_t registers[budgetBytes];
+        static const int maxBuckets = 32;
+        uint32_t bucketEpochs[maxBuckets];  //the bucket index of time each holds, 0 if none
+
+        int precision = 0;
+        int registerCount = 0;              //per bucket
+        int bucketCount = 0;
+        uint32_t bucketMs = 300000;
+
+        int minRSSI = -128;
+        int maxRSSI = 0;
+        int channel = 0;                    //0 for any
+};
+
+#endif
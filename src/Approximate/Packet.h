@@ -13,12 +13,27 @@
 
 class Packet {
     public:
+        typedef enum {
+            DIRECT,     //ToDS=0 FromDS=0 - addr1 = dst, addr2 = src, addr3 = bssid
+            TO_DS,      //ToDS=1 FromDS=0 - addr1 = bssid, addr2 = src, addr3 = dst
+            FROM_DS,    //ToDS=0 FromDS=1 - addr1 = dst, addr2 = bssid, addr3 = src
+            WDS         //ToDS=1 FromDS=1 - addr1 = receiver, addr2 = transmitter, addr3 = dst, addr4 = src
+        } Distribution;
+
+        Distribution distribution = DIRECT;
+        eth_addr receiver = {{0,0,0,0,0,0}};
+        eth_addr transmitter = {{0,0,0,0,0,0}};
         eth_addr src = {{0,0,0,0,0,0}};
         eth_addr dst = {{0,0,0,0,0,0}};
         eth_addr bssid = {{0,0,0,0,0,0}};
         int rssi = 0;
         int channel = -1;
         uint16_t payloadLengthBytes = 0;
+        uint16_t headerLengthBytes = 0;
+        uint8_t subtype = 0;
+        uint16_t sequenceControl = 0;   //sequence number (12 bits) then fragment number (4 bits)
+        bool retry = false;
+        uint64_t receivedAtMs = 0;      //stamped once, as the frame arrives
 };
 
 #endif
\ No newline at end of file
@@ -8,8 +8,10 @@
 
 #include "PacketSniffer.h"
 
-PacketSniffer::PacketEventHandler PacketSniffer::packetEventHandler = NULL;
-PacketSniffer::ChannelEventHandler PacketSniffer::channelEventHandler = NULL;
+PacketSniffer::PacketEventRegistration PacketSniffer::packetEventHandlers[PacketSniffer::maxEventHandlers];
+int PacketSniffer::packetEventHandlerCount = 0;
+PacketSniffer::ChannelEventRegistration PacketSniffer::channelEventHandlers[PacketSniffer::maxEventHandlers];
+int PacketSniffer::channelEventHandlerCount = 0;
 bool PacketSniffer::running = false;
 
 PacketSniffer::PacketSniffer() {
@@ -35,8 +37,8 @@ bool PacketSniffer::begin() {
       
     #elif defined(ESP32)
       bool CSI_ENABLED = false; 
-      #if defined(CONFIG_ESP32_WIFI_CSI_ENABLED)
-        CSI_ENABLED = (CONFIG_ESP32_WIFI_CSI_ENABLED == 1) && channelEventHandler;
+      #if defined(CONFIG_ESP32_WIFI_CSI_ENABLED) && APPROXIMATE_CSI_ENABLED
+        CSI_ENABLED = (CONFIG_ESP32_WIFI_CSI_ENABLED == 1) && channelEventHandlerCount > 0;
         if(CSI_ENABLED) {
           //TODO - This shouldn't be necessary - Approximate::connectWiFi() should handles this as esp_wifi_set_csi() needs, but...
           esp_wifi_disconnect();
@@ -170,12 +172,67 @@ void PacketSniffer::setChannelScan(bool channelScan) {
   this->channelScan = channelScan;
 }
 
-void PacketSniffer::setPacketEventHandler(PacketEventHandler packetEventHandler) {
-  this -> packetEventHandler = packetEventHandler;
+bool PacketSniffer::addPacketEventHandler(PacketEventHandler packetEventHandler, void *packetEventContext) {
+  bool success = false;
+
+  //adding the same handler and context again is harmless:
+  for(int n = 0; n < packetEventHandlerCount && !success; ++n) {
+    success = (packetEventHandlers[n].handler == packetEventHandler && packetEventHandlers[n].context == packetEventContext);
+  }
+
+  if(!success && packetEventHandler && packetEventHandlerCount < maxEventHandlers) {
+    packetEventHandlers[packetEventHandlerCount].handler = packetEventHandler;
+    packetEventHandlers[packetEventHandlerCount].context = packetEventContext;
+    packetEventHandlerCount++;
+    success = true;
+  }
+
+  return(success);
+}
+
+void PacketSniffer::removePacketEventHandler(PacketEventHandler packetEventHandler, void *packetEventContext) {
+  for(int n = 0; n < packetEventHandlerCount; ++n) {
+    if(packetEventHandlers[n].handler == packetEventHandler && packetEventHandlers[n].context == packetEventContext) {
+      packetEventHandlers[n] = packetEventHandlers[--packetEventHandlerCount];
+      n--;
+    }
+  }
+}
+
+bool PacketSniffer::addChannelEventHandler(ChannelEventHandler channelEventHandler, void *channelEventContext) {
+  bool success = false;
+
+  for(int n = 0; n < channelEventHandlerCount && !success; ++n) {
+    success = (channelEventHandlers[n].handler == channelEventHandler && channelEventHandlers[n].context == channelEventContext);
+  }
+
+  if(!success && channelEventHandler && channelEventHandlerCount < maxEventHandlers) {
+    channelEventHandlers[channelEventHandlerCount].handler = channelEventHandler;
+    channelEventHandlers[channelEventHandlerCount].context = channelEventContext;
+    channelEventHandlerCount++;
+    success = true;
+  }
+
+  return(success);
+}
+
+void PacketSniffer::removeChannelEventHandler(ChannelEventHandler channelEventHandler, void *channelEventContext) {
+  for(int n = 0; n < channelEventHandlerCount; ++n) {
+    if(channelEventHandlers[n].handler == channelEventHandler && channelEventHandlers[n].context == channelEventContext) {
+      channelEventHandlers[n] = channelEventHandlers[--channelEventHandlerCount];
+      n--;
+    }
+  }
+}
+
+void PacketSniffer::inject(wifi_promiscuous_pkt_t *packet, uint16_t len, int type) {
+  dispatchPacketEvent(packet, len, type);
 }
 
-void PacketSniffer::setChannelEventHandler(ChannelEventHandler channelEventHandler) {
-  this -> channelEventHandler = channelEventHandler;
+void PacketSniffer::dispatchPacketEvent(wifi_promiscuous_pkt_t *packet, uint16_t len, int type) {
+  for(int n = 0; n < packetEventHandlerCount; ++n) {
+    packetEventHandlers[n].handler(packetEventHandlers[n].context, packet, len, type);
+  }
 }
 
 void PacketSniffer::rxCallback_8266(uint8_t *buf, uint16_t len) {
@@ -204,13 +261,15 @@ void PacketSniffer::rxCallback_32(void* buf, wifi_promiscuous_pkt_type_t type) {
 }
 
 void PacketSniffer::rxCallback(wifi_promiscuous_pkt_t *packet, uint16_t len, wifi_promiscuous_pkt_type_t type) {
-  if (running && packetEventHandler) {
-    packetEventHandler(packet, len, (int) type);
+  if (running) {
+    dispatchPacketEvent(packet, len, (int) type);
   }
 }
 
 void PacketSniffer::csiCallback_32(void *ctx, wifi_csi_info_t *data) {
-  if (running && channelEventHandler) {
-    channelEventHandler(data);
+  if (running) {
+    for(int n = 0; n < channelEventHandlerCount; ++n) {
+      channelEventHandlers[n].handler(channelEventHandlers[n].context, data);
+    }
   }
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #define PacketSniffer_h
 
 #include <Arduino.h>
+#include "Config.h"
 #include "eth_addr.h"
 #include "wifi_pkt.h"
 
@@ -28,11 +29,19 @@ class PacketSniffer {
     bool getChannelScan();
     void setChannelScan(bool channelScan);
 
-    typedef void (*PacketEventHandler)(wifi_promiscuous_pkt_t *packet, uint16_t len, int type);
-    void setPacketEventHandler(PacketEventHandler packetEventHandler);
+    //every frame is passed to each handler added, with its context - typically the instance that added it:
+    static const int maxEventHandlers = 4;
 
-    typedef void (*ChannelEventHandler)(wifi_csi_info_t *data);
-    void setChannelEventHandler(ChannelEventHandler channelEventHandler);
+    typedef void (*PacketEventHandler)(void *context, wifi_promiscuous_pkt_t *packet, uint16_t len, int type);
+    bool addPacketEventHandler(PacketEventHandler packetEventHandler, void *packetEventContext = NULL);
+    void removePacketEventHandler(PacketEventHandler packetEventHandler, void *packetEventContext = NULL);
+
+    typedef void (*ChannelEventHandler)(void *context, wifi_csi_info_t *data);
+    bool addChannelEventHandler(ChannelEventHandler channelEventHandler, void *channelEventContext = NULL);
+    void removeChannelEventHandler(ChannelEventHandler channelEventHandler, void *channelEventContext = NULL);
+
+    //hand a frame to the packet handlers as the radio would - for testing without one:
+    void inject(wifi_promiscuous_pkt_t *packet, uint16_t len, int type);
 
   private:
     PacketSniffer();
@@ -54,8 +63,22 @@ class PacketSniffer {
 
     static void csiCallback_32(void *ctx, wifi_csi_info_t *data);
 
-    static PacketEventHandler packetEventHandler;
-    static ChannelEventHandler channelEventHandler;
+    //the radio callbacks carry no context of their own, so the handlers added are held here:
+    typedef struct {
+      PacketEventHandler handler;
+      void *context;
+    } PacketEventRegistration;
+    static PacketEventRegistration packetEventHandlers[maxEventHandlers];
+    static int packetEventHandlerCount;
+
+    typedef struct {
+      ChannelEventHandler handler;
+      void *context;
+    } ChannelEventRegistration;
+    static ChannelEventRegistration channelEventHandlers[maxEventHandlers];
+    static int channelEventHandlerCount;
+
+    static void dispatchPacketEvent(wifi_promiscuous_pkt_t *packet, uint16_t len, int type);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+/*
+    RSSIHistory.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "RSSIHistory.h"
+#include "Device.h"
+
+#if APPROXIMATE_RSSI_HISTORY_ENABLED
+
+//the longest encoding of a sample - a delta of two bytes and a gap of five:
+static const int maxEntryLengthBytes = 7;
+
+RSSIHistory::RSSIHistory() {
+}
+
+void RSSIHistory::clear() {
+    tail = 0;
+    usedBytes = 0;
+    sampleCount = 0;
+    pendingCount = 0;
+    pendingSumRSSI = 0;
+}
+
+bool RSSIHistory::isEmpty() {
+    return(sampleCount == 0 && pendingCount == 0);
+}
+
+void RSSIHistory::add(int rssi, uint64_t timeMs) {
+    uint32_t timeS = timeMs / 1000;
+
+    //unknown, or out of order, readings are passed over:
+    bool inOrder = !(sampleCount > 0 && timeS <= newestTimeS) && !(pendingCount > 0 && timeS < pendingTimeS);
+    if(rssi < 0 && inOrder) {
+        if(pendingCount > 0 && timeS != pendingTimeS) {
+            commit(pendingSumRSSI / pendingCount, pendingTimeS);
+            pendingCount = 0;
+            pendingSumRSSI = 0;
+        }
+
+        if(pendingCount < 0xFF) {
+            pendingTimeS = timeS;
+            pendingSumRSSI += max(rssi, -128);
+            pendingCount++;
+        }
+    }
+}
+
+void RSSIHistory::commit(int rssi, uint32_t timeS) {
+    if(sampleCount == 0) {
+        oldestRSSI = newestRSSI = rssi;
+        oldestTimeS = newestTimeS = timeS;
+        sampleCount = 1;
+    }
+    else {
+        //room is made for the longest entry, so it is never split by a drop:
+        while(lengthBytes - usedBytes < maxEntryLengthBytes && sampleCount > 1) dropOldest();
+
+        int delta = rssi - newestRSSI;
+        uint32_t gapS = timeS - newestTimeS;
+        uint32_t zigzag = (delta < 0) ? ((-delta * 2) - 1) : (delta * 2);
+
+        int offset = (tail + usedBytes) % lengthBytes;
+        int length = writeVarint((zigzag << 1) | (gapS > 1 ? 1 : 0), offset);
+        if(gapS > 1) length += writeVarint(gapS - 2, (offset + length) % lengthBytes);
+
+        usedBytes += length;
+        sampleCount++;
+        newestRSSI = rssi;
+        newestTimeS = timeS;
+    }
+}
+
+void RSSIHistory::dropOldest() {
+    //the second oldest becomes the oldest, held whole:
+    uint32_t value = 0;
+    uint32_t gapS = 1;
+    int length = readVarint(value, tail);
+    if(value & 1) {
+        length += readVarint(gapS, (tail + length) % lengthBytes);
+        gapS += 2;
+    }
+
+    uint32_t zigzag = value >> 1;
+    oldestRSSI += (zigzag & 1) ? -(int) ((zigzag + 1) / 2) : (int) (zigzag / 2);
+    oldestTimeS += gapS;
+
+    tail = (tail + length) % lengthBytes;
+    usedBytes -= length;
+    sampleCount--;
+}
+
+int RSSIHistory::writeVarint(uint32_t value, int offset) {
+    int length = 0;
+
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        ring[(offset + length++) % lengthBytes] = b | (value ? 0x80 : 0);
+    } while(value);
+
+    return(length);
+}
+
+int RSSIHistory::readVarint(uint32_t &value, int offset) {
+    int length = 0;
+    uint8_t b = 0;
+
+    value = 0;
+    do {
+        b = ring[(offset + length) % lengthBytes];
+        value |= (uint32_t) (b & 0x7F) << (7 * length);
+        length++;
+    } while((b & 0x80) && length < 5);
+
+    return(length);
+}
+
+int RSSIHistory::getSamples(int8_t *rssi, uint32_t *timeS, int maxCount, uint32_t windowMs, uint64_t nowMs) {
+    int count = 0;
+    uint32_t fromS = (nowMs > windowMs) ? (nowMs - windowMs) / 1000 : 0;
+
+    if(sampleCount > 0) {
+        int8_t r = oldestRSSI;
+        uint32_t t = oldestTimeS;
+        int offset = tail;
+        for(int n = 0; n < sampleCount && count < maxCount; ++n) {
+            if(n > 0) {
+                uint32_t value = 0;
+                uint32_t gapS = 1;
+                offset = (offset + readVarint(value, offset)) % lengthBytes;
+                if(value & 1) {
+                    offset = (offset + readVarint(gapS, offset)) % lengthBytes;
+                    gapS += 2;
+                }
+                uint32_t zigzag = value >> 1;
+                r += (zigzag & 1) ? -(int) ((zigzag + 1) / 2) : (int) (zigzag / 2);
+                t += gapS;
+            }
+
+            if(t >= fromS) {
+                if(rssi) rssi[count] = r;
+                if(timeS) timeS[count] = t;
+                count++;
+            }
+        }
+    }
+
+    if(pendingCount > 0 && pendingTimeS >= fromS && count < maxCount) {
+        if(rssi) rssi[count] = pendingSumRSSI / pendingCount;
+        if(timeS) timeS[count] = pendingTimeS;
+        count++;
+    }
+
+    return(count);
+}
+
+float RSSIHistory::getSlope(uint32_t windowMs, uint64_t nowMs) {
+    float slope = 0.0;
+
+    int8_t rssi[maxSamples];
+    uint32_t timeS[maxSamples];
+    int count = getSamples(rssi, timeS, maxSamples, windowMs, nowMs);
+
+    //a least squares fit, with time taken from the first sample:
+    if(count > 1) {
+        float sumT = 0, sumR = 0, sumTT = 0, sumTR = 0;
+        for(int n = 0; n < count; ++n) {
+            float t = timeS[n] - timeS[0];
+            sumT += t;
+            sumR += rssi[n];
+            sumTT += t * t;
+            sumTR += t * rssi[n];
+        }
+
+        float d = (count * sumTT) - (sumT * sumT);
+        if(d > 0) slope = ((count * sumTR) - (sumT * sumR)) / d;
+    }
+
+    return(slope);
+}
+
+int RSSIHistory::getMinRSSI(uint32_t windowMs, uint64_t nowMs) {
+    int minRSSI = APPROXIMATE_UNKNOWN_RSSI;
+
+    int8_t rssi[maxSamples];
+    int count = getSamples(rssi, NULL, maxSamples, windowMs, nowMs);
+    for(int n = 0; n < count; ++n) {
+        if(n == 0 || rssi[n] < minRSSI) minRSSI = rssi[n];
+    }
+
+    return(minRSSI);
+}
+
+int RSSIHistory::getMaxRSSI(uint32_t windowMs, uint64_t nowMs) {
+    int maxRSSI = APPROXIMATE_UNKNOWN_RSSI;
+
+    int8_t rssi[maxSamples];
+    int count = getSamples(rssi, NULL, maxSamples, windowMs, nowMs);
+    for(int n = 0; n < count; ++n) {
+        if(n == 0 || rssi[n] > maxRSSI) maxRSSI = rssi[n];
+    }
+
+    return(maxRSSI);
+}
+
+int RSSIHistory::getPercentileRSSI(int percentile, uint32_t windowMs, uint64_t nowMs) {
+    int percentileRSSI = APPROXIMATE_UNKNOWN_RSSI;
+
+    int8_t rssi[maxSamples];
+    int count = getSamples(rssi, NULL, maxSamples, windowMs, nowMs);
+    if(count > 0) {
+        //few enough to sort by insertion:
+        for(int i = 1; i < count; ++i) {
+            int8_t r = rssi[i];
+            int j = i - 1;
+            while(j >= 0 && rssi[j] > r) {
+                rssi[j + 1] = rssi[j];
+                j--;
+            }
+            rssi[j + 1] = r;
+        }
+
+        //the nearest rank:
+        int rank = ((constrain(percentile, 0, 100) * count) + 99) / 100;
+        percentileRSSI = rssi[constrain(rank - 1, 0, count - 1)];
+    }
+
+    return(percentileRSSI);
+}
+
+#endif
\ No newline at end of file
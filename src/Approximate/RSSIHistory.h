@@ -0,0 +1,66 @@
+/*
+    RSSIHistory.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef RSSIHistory_h
+#define RSSIHistory_h
+
+#include <Arduino.h>
+#include "Config.h"
+
+#if APPROXIMATE_RSSI_HISTORY_BYTES < 8 || APPROXIMATE_RSSI_HISTORY_BYTES > 255
+    #error "APPROXIMATE_RSSI_HISTORY_BYTES must be from 8 to 255"
+#endif
+
+//A device's recent RSSI, one sample a second, held in a fixed ring of bytes:
+//
+//The oldest sample is held whole, and each after as the change from the one before - a varint of the zigzagged RSSI delta, shifted
+//left by one, its low bit set if a varint of the gap in seconds (less two) follows. A sample a second later, within 31dB, is one byte.
+class RSSIHistory {
+    public:
+        static const int lengthBytes = APPROXIMATE_RSSI_HISTORY_BYTES;
+        static const int maxSamples = lengthBytes + 2;  //those encoded, the oldest and the current second
+
+        RSSIHistory();
+
+        //readings within the same second are averaged:
+        void add(int rssi, uint64_t timeMs);
+        void clear();
+        bool isEmpty();
+
+        //the samples no older than the window, oldest first - returns the number written:
+        int getSamples(int8_t *rssi, uint32_t *timeS, int maxCount, uint32_t windowMs, uint64_t nowMs);
+
+        //over the samples within the window - APPROXIMATE_UNKNOWN_RSSI (or 0) if there are none:
+        float getSlope(uint32_t windowMs, uint64_t nowMs);     //dB a second, positive if approaching
+        int getMinRSSI(uint32_t windowMs, uint64_t nowMs);
+        int getMaxRSSI(uint32_t windowMs, uint64_t nowMs);
+        int getPercentileRSSI(int percentile, uint32_t windowMs, uint64_t nowMs);
+
+    private:
+        uint8_t ring[lengthBytes];
+        uint8_t tail = 0;           //the oldest encoded byte
+        uint8_t usedBytes = 0;
+        uint8_t sampleCount = 0;    //including the oldest
+
+        int8_t oldestRSSI = 0;
+        uint32_t oldestTimeS = 0;
+        int8_t newestRSSI = 0;
+        uint32_t newestTimeS = 0;
+
+        //the second being averaged:
+        uint32_t pendingTimeS = 0;
+        int16_t pendingSumRSSI = 0;
+        uint8_t pendingCount = 0;
+
+        void commit(int rssi, uint32_t timeS);
+        void dropOldest();
+        int writeVarint(uint32_t value, int offset);
+        int readVarint(uint32_t &value, int offset);
+};
+
+#endif
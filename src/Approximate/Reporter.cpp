@@ -0,0 +1,165 @@
+/*
+    Reporter.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "Reporter.h"
+
+#if APPROXIMATE_REPORTER_ENABLED
+
+static_assert((Reporter::queueLength & (Reporter::queueLength - 1)) == 0, "APPROXIMATE_REPORTER_QUEUE_LENGTH should be a power of two");
+
+Reporter::Reporter() {
+}
+
+bool Reporter::begin(IPAddress collectorIPAddress, uint16_t collectorPort, uint16_t nodeId) {
+    this -> collectorIPAddress = collectorIPAddress;
+    this -> collectorPort = collectorPort;
+    this -> nodeId = nodeId;
+
+    //discard anything queued before - as the consumer:
+    __atomic_store_n(&tail, __atomic_load_n(&head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    lastFlushAtMs = millis();
+    running = true;
+
+    return(running);
+}
+
+void Reporter::end() {
+    if(running) {
+        flush();
+        udp.stop();
+        running = false;
+    }
+}
+
+void Reporter::loop() {
+    if(running && getQueuedCount() > 0 && WiFi.status() == WL_CONNECTED) {
+        if(getQueuedCount() >= (uint32_t) ObservationBatch::maxObservations || (millis() - lastFlushAtMs) >= (unsigned long) flushIntervalMs) {
+            flush();
+        }
+    }
+}
+
+bool Reporter::isRunning() {
+    return(running);
+}
+
+bool Reporter::isPending() {
+    return(running && getQueuedCount() > 0);
+}
+
+uint32_t Reporter::getQueuedCount() {
+    return(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+}
+
+bool Reporter::report(Device *device, uint64_t timeMs) {
+    bool success = false;
+
+    if(device) {
+        success = report(device -> getMacAddressKey(), device -> getRSSI(), device -> getChannel(), timeMs);
+    }
+
+    return(success);
+}
+
+bool Reporter::report(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs) {
+    bool success = false;
+
+    if(running) {
+        //full until the next flush - the newest is dropped, so that the queue stays in time order:
+        uint32_t head = this -> head;
+        if(head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) < (uint32_t) queueLength) {
+            QueuedObservation &observation = queue[head & (queueLength - 1)];
+            observation.macAddress = macAddressKey;
+            observation.rssi = rssi;
+            observation.channel = channel > 0 ? channel : 0;
+            observation.timeMs = (uint32_t) timeMs;
+            __atomic_store_n(&(this -> head), head + 1, __ATOMIC_RELEASE);
+            success = true;
+        }
+        else droppedObservationCount++;
+    }
+
+    return(success);
+}
+
+bool Reporter::flush() {
+    bool success = true;
+
+    lastFlushAtMs = millis();
+
+    //held until there is a connection:
+    if(running && WiFi.status() == WL_CONNECTED) {
+        uint32_t tail = this -> tail;
+        uint32_t head = __atomic_load_n(&(this -> head), __ATOMIC_ACQUIRE);
+
+        while(tail != head) {
+            uint64_t sentAtMs = clock -> getTimeMs();
+
+            int observationCount = 0;
+            for(; tail != head && observationCount < ObservationBatch::maxObservations; ++tail) {
+                QueuedObservation &queuedObservation = queue[tail & (queueLength - 1)];
+                Observation &observation = observations[observationCount++];
+
+                observation.macAddress = queuedObservation.macAddress;
+                observation.rssi = queuedObservation.rssi;
+                observation.channel = queuedObservation.channel;
+                observation.nodeId = nodeId;
+                //the full time, from its age by the low 32 bits:
+                observation.timeMs = sentAtMs - (uint32_t) ((uint32_t) sentAtMs - queuedObservation.timeMs);
+            }
+            __atomic_store_n(&(this -> tail), tail, __ATOMIC_RELEASE);
+
+            int lengthBytes = ObservationBatch::encode(observations, observationCount, nodeId, sequence, sentAtMs, batch, sizeof(batch));
+
+            bool sent = false;
+            if(udp.beginPacket(collectorIPAddress, collectorPort)) {
+                udp.write(batch, lengthBytes);
+                sent = udp.endPacket();
+            }
+
+            if(sent) {
+                sentObservationCount += observationCount;
+                sentBatchCount++;
+            }
+            else unsentObservationCount += observationCount;
+            success = success && sent;
+
+            //counted even if not sent, so the collector sees the loss:
+            sequence++;
+        }
+    }
+    else success = false;
+
+    return(success);
+}
+
+void Reporter::setFlushIntervalMs(int flushIntervalMs) {
+    this -> flushIntervalMs = max(flushIntervalMs, 0);
+}
+
+uint16_t Reporter::getNodeId() {
+    return(nodeId);
+}
+
+void Reporter::setClock(Clock *clock) {
+    this -> clock = clock ? clock : &localClock;
+}
+
+uint32_t Reporter::getSentObservationCount() {
+    return(sentObservationCount);
+}
+
+uint32_t Reporter::getDroppedObservationCount() {
+    return(droppedObservationCount + unsentObservationCount);
+}
+
+uint32_t Reporter::getSentBatchCount() {
+    return(sentBatchCount);
+}
+
+#endif
\ No newline at end of file
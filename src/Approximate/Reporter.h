@@ -0,0 +1,100 @@
+/*
+    Reporter.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef Reporter_h
+#define Reporter_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "eth_addr.h"
+
+#if defined(ESP8266)
+    #include <ESP8266WiFi.h>        //https://github.com/esp8266/Arduino
+
+#elif defined(ESP32)
+    #include <WiFi.h>               //https://github.com/espressif/arduino-esp32/
+
+#endif
+
+#include <WiFiUdp.h>
+
+#include "Clock.h"
+#include "Device.h"
+#include "Observation.h"
+
+//Sends this node's observations to a Collector over UDP, in batches:
+//
+//Observations are reported from the WiFi task and sent from loop(), so they pass through a single producer, single consumer queue.
+//They are held there while there is no connection - on an ESP8266 until Approximate's next uplink window.
+class Reporter {
+    public:
+        static const int queueLength = APPROXIMATE_REPORTER_QUEUE_LENGTH;
+
+        Reporter();
+
+        bool begin(IPAddress collectorIPAddress, uint16_t collectorPort = 5005, uint16_t nodeId = 0);
+        void end();
+        void loop();
+        bool isRunning();
+
+        //only queued - sent from loop(), when a batch is full or the flush interval has passed:
+        bool report(Device *device, uint64_t timeMs);
+        bool report(uint64_t macAddressKey, int rssi, int channel, uint64_t timeMs);
+        bool flush();
+        bool isPending();
+        uint32_t getQueuedCount();
+
+        void setFlushIntervalMs(int flushIntervalMs);
+        uint16_t getNodeId();
+
+        //the clock that reported times are taken from - so that each batch is stamped by the same:
+        void setClock(Clock *clock);
+
+        uint32_t getSentObservationCount();
+        uint32_t getDroppedObservationCount();
+        uint32_t getSentBatchCount();
+
+    private:
+        Reporter(Reporter const&);
+        void operator=(Reporter const&);
+
+        WiFiUDP udp;
+        IPAddress collectorIPAddress;
+        uint16_t collectorPort = 0;
+        uint16_t nodeId = 0;
+        bool running = false;
+
+        Clock localClock;
+        Clock *clock = &localClock;
+
+        //report() only moves the head, flush() only the tail:
+        typedef struct {
+            uint64_t macAddress : 48;
+            int64_t rssi : 8;
+            uint64_t channel : 8;
+            uint32_t timeMs;    //low 32 bits of the clock
+        } __attribute__((packed)) QueuedObservation;
+
+        QueuedObservation queue[queueLength];
+        uint32_t head = 0;
+        uint32_t tail = 0;
+
+        Observation observations[ObservationBatch::maxObservations];
+        uint8_t batch[ObservationBatch::headerLengthBytes + (ObservationBatch::maxObservations * ObservationBatch::observationLengthBytes)];
+        uint16_t sequence = 0;  //a gap at the collector is a lost batch
+
+        int flushIntervalMs = 1000;
+        unsigned long lastFlushAtMs = 0;
+
+        uint32_t sentObservationCount = 0;
+        uint32_t droppedObservationCount = 0;   //by report() - the queue was full
+        uint32_t unsentObservationCount = 0;    //by flush() - the batch could not be sent
+        uint32_t sentBatchCount = 0;
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+    SequenceLock.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef SequenceLock_h
+#define SequenceLock_h
+
+#include <stdint.h>
+
+//For state with a single writer - the WiFi task - read from loop(): the writer never waits, and a reader retries if a write overlapped its read.
+//
+//  writer:   lock.beginWrite(); ... lock.endWrite();
+//  reader:   uint32_t sequence; do { sequence = lock.beginRead(); ... } while(lock.retryRead(sequence));
+class SequenceLock {
+    private:
+        uint32_t sequence = 0;              //odd while a write is under way
+
+    public:
+        void beginWrite() {
+            __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+        }
+
+        void endWrite() {
+            __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+        }
+
+        uint32_t beginRead() {
+            uint32_t s;
+            while((s = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE)) & 1);
+            return(s);
+        }
+
+        bool retryRead(uint32_t s) {
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            return(__atomic_load_n(&sequence, __ATOMIC_RELAXED) != s);
+        }
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+    TrafficCounter.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "TrafficCounter.h"
+
+#if APPROXIMATE_TRAFFIC_COUNTER_ENABLED
+
+//See: Cormode and Muthukrishnan, An improved data stream summary: the count-min sketch and its applications (2005)
+
+TrafficCounter::TrafficCounter() {
+    reset();
+}
+
+void TrafficCounter::clear() {
+    //only asked for here - the counts are written by add(), on the WiFi task, which clears them before its next:
+    __atomic_store_n(&clearRequestCount, clearRequestCount + 1, __ATOMIC_RELEASE);
+}
+
+bool TrafficCounter::isClearPending() {
+    return(__atomic_load_n(&clearRequestCount, __ATOMIC_ACQUIRE) != clearedCount);
+}
+
+void TrafficCounter::reset() {
+    memset(sketch, 0, sizeof(sketch));
+    memset(totalBytes, 0, sizeof(totalBytes));
+    memset(top, 0, sizeof(top));
+    memset(topCount, 0, sizeof(topCount));
+}
+
+void TrafficCounter::add(uint64_t macAddressKey, Direction direction, uint32_t bytes) {
+    lock.beginWrite();
+
+    uint32_t requestCount = __atomic_load_n(&clearRequestCount, __ATOMIC_ACQUIRE);
+    if(requestCount != clearedCount) {
+        reset();
+        __atomic_store_n(&clearedCount, requestCount, __ATOMIC_RELEASE);
+    }
+
+    if(bytes > 0) {
+        //each row's column is taken from the one hash - h1 + (row * h2):
+        uint64_t h = Device::getMacAddressHash(macAddressKey);
+        uint32_t h1 = h;
+        uint32_t h2 = (h >> 32) | 1;
+
+        int columns[depth];
+        uint32_t estimate = UINT32_MAX;
+        for(int row = 0; row < depth; ++row) {
+            columns[row] = (h1 + (row * h2)) % width;
+            estimate = min(estimate, sketch[direction][row][columns[row]]);
+        }
+
+        //a conservative update - no counter is raised above the new estimate:
+        estimate = (estimate > UINT32_MAX - bytes) ? UINT32_MAX : estimate + bytes;
+        for(int row = 0; row < depth; ++row) {
+            uint32_t &counter = sketch[direction][row][columns[row]];
+            if(counter < estimate) counter = estimate;
+        }
+
+        totalBytes[direction] += bytes;
+        updateTop(top[direction], topCount[direction], macAddressKey, estimate);
+    }
+
+    lock.endWrite();
+}
+
+uint32_t TrafficCounter::getBytes(uint64_t macAddressKey, Direction direction) {
+    uint64_t h = Device::getMacAddressHash(macAddressKey);
+    uint32_t h1 = h;
+    uint32_t h2 = (h >> 32) | 1;
+
+    //read again if add() wrote meanwhile:
+    uint32_t estimate;
+    uint32_t sequence;
+    do {
+        sequence = lock.beginRead();
+
+        estimate = UINT32_MAX;
+        for(int row = 0; row < depth; ++row) {
+            estimate = min(estimate, sketch[direction][row][(h1 + (row * h2)) % width]);
+        }
+        if(isClearPending()) estimate = 0;
+    } while(lock.retryRead(sequence));
+
+    return(estimate);
+}
+
+uint32_t TrafficCounter::getTotalBytes(Direction direction) {
+    return(isClearPending() ? 0 : totalBytes[direction]);
+}
+
+void TrafficCounter::updateTop(Entry *heap, int &count, uint64_t macAddressKey, uint32_t bytes) {
+    int index = -1;
+    for(int n = 0; n < count && index < 0; ++n) {
+        if(heap[n].macAddress == macAddressKey) index = n;
+    }
+
+    if(index >= 0) {
+        //already held - its count only grows, so it can only move away from the root:
+        heap[index].bytes = bytes;
+        siftDown(heap, count, index);
+    }
+    else if(count < maxTopCount) {
+        //not yet full - added at the end and moved up:
+        index = count++;
+        heap[index].macAddress = macAddressKey;
+        heap[index].bytes = bytes;
+        while(index > 0 && heap[(index - 1) / 2].bytes > heap[index].bytes) {
+            Entry e = heap[index];
+            heap[index] = heap[(index - 1) / 2];
+            heap[(index - 1) / 2] = e;
+            index = (index - 1) / 2;
+        }
+    }
+    else if(bytes > heap[0].bytes) {
+        //heavier than the lightest held - which it replaces:
+        heap[0].macAddress = macAddressKey;
+        heap[0].bytes = bytes;
+        siftDown(heap, count, 0);
+    }
+}
+
+void TrafficCounter::siftDown(Entry *heap, int count, int index) {
+    bool sifting = true;
+    while(sifting) {
+        int smallest = index;
+        int left = (2 * index) + 1;
+        int right = left + 1;
+        if(left < count && heap[left].bytes < heap[smallest].bytes) smallest = left;
+        if(right < count && heap[right].bytes < heap[smallest].bytes) smallest = right;
+
+        if(smallest != index) {
+            Entry e = heap[index];
+            heap[index] = heap[smallest];
+            heap[smallest] = e;
+            index = smallest;
+        }
+        else sifting = false;
+    }
+}
+
+int TrafficCounter::getTop(Direction direction, Entry *entries, int n) {
+    //the heap is small, so a copy is taken - again if add() wrote meanwhile - and sorted by insertion:
+    Entry sorted[maxTopCount];
+    int sortedCount;
+    uint32_t sequence;
+    do {
+        sequence = lock.beginRead();
+
+        sortedCount = isClearPending() ? 0 : constrain(topCount[direction], 0, maxTopCount);
+        memcpy(sorted, top[direction], sortedCount * sizeof(Entry));
+    } while(lock.retryRead(sequence));
+
+    int count = constrain(n, 0, sortedCount);
+    for(int i = 1; i < sortedCount; ++i) {
+        Entry e = sorted[i];
+        int j = i - 1;
+        while(j >= 0 && sorted[j].bytes < e.bytes) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = e;
+    }
+    if(entries) memcpy(entries, sorted, count * sizeof(Entry));
+
+    return(count);
+}
+
+void TrafficCounter::setReportHandler(ReportHandler reportHandler, uint32_t reportIntervalMs, bool clearAfterReport) {
+    this -> reportHandler = reportHandler;
+    this -> reportIntervalMs = max(reportIntervalMs, (uint32_t) 1000);
+    this -> clearAfterReport = clearAfterReport;
+}
+
+void TrafficCounter::loop(uint64_t nowMs) {
+    if(reportedAtMs == 0 || nowMs < reportedAtMs) reportedAtMs = nowMs;
+
+    if(reportHandler && (nowMs - reportedAtMs) >= reportIntervalMs) {
+        reportedAtMs = nowMs;
+        reportHandler(this);
+        if(clearAfterReport) clear();
+    }
+}
+
+#endif
\ No newline at end of file
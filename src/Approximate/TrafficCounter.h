@@ -0,0 +1,80 @@
+/*
+    TrafficCounter.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef TrafficCounter_h
+#define TrafficCounter_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Device.h"
+#include "SequenceLock.h"
+
+//Finds the devices moving the most data, in fixed memory - a count-min sketch and a heap of the heaviest, for each direction:
+class TrafficCounter {
+    public:
+        typedef enum {
+            UPLOAD,
+            DOWNLOAD
+        } Direction;
+
+        typedef struct {
+            uint64_t macAddress;
+            uint32_t bytes;     //an estimate - never less than the true count
+        } Entry;
+
+        typedef void (*ReportHandler)(TrafficCounter *trafficCounter);
+
+        static const int depth = 4;
+        static const int width = APPROXIMATE_TRAFFIC_BUDGET_BYTES / (2 * depth * sizeof(uint32_t));
+        static const int maxTopCount = APPROXIMATE_TRAFFIC_TOP_N;
+
+        TrafficCounter();
+
+        void add(uint64_t macAddressKey, Direction direction, uint32_t bytes);
+        uint32_t getBytes(uint64_t macAddressKey, Direction direction);
+        uint32_t getTotalBytes(Direction direction);
+
+        //the heaviest devices, heaviest first - returns the number written:
+        int getTop(Direction direction, Entry *entries, int n);
+
+        //called every interval from loop() - the counts then start again, unless told otherwise:
+        void setReportHandler(ReportHandler reportHandler, uint32_t reportIntervalMs = 60000, bool clearAfterReport = true);
+        void loop(uint64_t nowMs);
+
+        //safe to call from loop() while frames are being added - the counts read as cleared at once:
+        void clear();
+
+    private:
+        TrafficCounter(TrafficCounter const&);
+        void operator=(TrafficCounter const&);
+
+        uint32_t sketch[2][depth][width];
+        uint32_t totalBytes[2];
+
+        //written by add() on the WiFi task, read from loop():
+        SequenceLock lock;
+
+        //clear() only counts a request, for add() to carry out:
+        uint32_t clearRequestCount = 0;
+        uint32_t clearedCount = 0;
+        bool isClearPending();
+        void reset();
+
+        //a min-heap, so the lightest of the heaviest is at the root:
+        Entry top[2][maxTopCount];
+        int topCount[2];
+        void updateTop(Entry *heap, int &count, uint64_t macAddressKey, uint32_t bytes);
+        static void siftDown(Entry *heap, int count, int index);
+
+        ReportHandler reportHandler = NULL;
+        uint32_t reportIntervalMs = 60000;
+        bool clearAfterReport = true;
+        uint64_t reportedAtMs = 0;
+};
+
+#endif
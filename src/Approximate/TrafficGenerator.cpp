@@ -0,0 +1,149 @@
+/*
+    TrafficGenerator.cpp
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#include "TrafficGenerator.h"
+
+#if APPROXIMATE_TRAFFIC_GENERATOR_ENABLED
+
+TrafficGenerator::TrafficGenerator() {
+}
+
+void TrafficGenerator::init(int stationCount, int bssidCount, int randomisedPercent, int channel) {
+    this -> stationCount = constrain(stationCount, 1, maxStations);
+    this -> bssidCount = constrain(bssidCount, 1, maxBssids);
+    this -> channel = channel;
+
+    for(int n = 0; n < this -> bssidCount; ++n) randomMacAddress(bssids[n], false);
+
+    for(int n = 0; n < this -> stationCount; ++n) {
+        Station &station = stations[n];
+
+        station.randomised = random(100) < randomisedPercent;
+        randomMacAddress(station.macAddress, station.randomised);
+        station.bssidIndex = n % this -> bssidCount;
+        station.present = random(2) == 0;
+        station.rssi = random(-90, -30);
+        station.rssiDrift = 0;
+        station.sequence = random(0x1000);
+        station.changesAtMs = random(minDwellMs, maxDwellMs);
+    }
+}
+
+wifi_promiscuous_pkt_t *TrafficGenerator::next(uint64_t nowMs, uint16_t &len, int &type) {
+    wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *) frame;
+    memset(frame, 0, sizeof(frame));
+
+    Station *station = nextPresentStation(nowMs);
+    move(*station);
+
+    pkt -> rx_ctrl.rssi = station -> rssi;
+    pkt -> rx_ctrl.channel = channel;
+
+    wifi_data_hdr *header = (wifi_data_hdr *) pkt -> payload;
+    uint8_t *bssid = bssids[station -> bssidIndex];
+    uint16_t fctl = WIFI_PKT_DATA << 2;
+    int payloadLengthBytes = 0;
+
+    //the mix - uplink and downlink data, some of it QoS, null frame heartbeats and probe requests:
+    long r = random(100);
+    if(r < 40) {
+        fctl |= WIFI_FCTL_TODS | (random(2) ? (WIFI_DATA_SUBTYPE_QOS << 4) : 0);
+        memcpy(header -> addr1.mac, bssid, 6);
+        memcpy(header -> addr2.mac, station -> macAddress, 6);
+        memcpy(header -> addr3.mac, bssid, 6);
+        payloadLengthBytes = random(40, 1500);
+    }
+    else if(r < 75) {
+        fctl |= WIFI_FCTL_FROMDS | (random(2) ? (WIFI_DATA_SUBTYPE_QOS << 4) : 0);
+        memcpy(header -> addr1.mac, station -> macAddress, 6);
+        memcpy(header -> addr2.mac, bssid, 6);
+        memcpy(header -> addr3.mac, bssid, 6);
+        payloadLengthBytes = random(40, 1500);
+    }
+    else if(r < 95) {
+        fctl |= WIFI_FCTL_TODS | WIFI_FCTL_PWRMGT | ((WIFI_DATA_SUBTYPE_NULL | (random(2) ? WIFI_DATA_SUBTYPE_QOS : 0)) << 4);
+        memcpy(header -> addr1.mac, bssid, 6);
+        memcpy(header -> addr2.mac, station -> macAddress, 6);
+        memcpy(header -> addr3.mac, bssid, 6);
+    }
+    else {
+        fctl = (WIFI_PKT_MGMT << 2) | (0x4 << 4);   //probe request
+        memset(header -> addr1.mac, 0xFF, 6);
+        memcpy(header -> addr2.mac, station -> macAddress, 6);
+        memset(header -> addr3.mac, 0xFF, 6);
+    }
+
+    header -> fctl = fctl;
+    header -> seqctl = (station -> sequence++ & 0x0FFF) << 4;
+
+    type = WIFI_FCTL_TYPE(fctl);
+    len = WIFI_DATA_HDR_LEN + payloadLengthBytes;
+
+    return(pkt);
+}
+
+TrafficGenerator::Station *TrafficGenerator::nextPresentStation(uint64_t nowMs) {
+    Station *station = NULL;
+    bool present = false;
+
+    //about half are present at any time, so a few tries are enough - otherwise the last tried sends anyway:
+    for(int n = 0; n < 8 && !present; ++n) {
+        station = &stations[random(stationCount)];
+        updatePresence(*station, nowMs);
+        present = station -> present;
+    }
+
+    return(station);
+}
+
+void TrafficGenerator::updatePresence(Station &station, uint64_t nowMs) {
+    while(nowMs >= station.changesAtMs) {
+        station.present = !station.present;
+        station.changesAtMs += random(minDwellMs, maxDwellMs);
+
+        if(station.present) {
+            if(station.randomised) randomMacAddress(station.macAddress, true);
+            station.rssi = random(-90, -30);
+        }
+    }
+}
+
+void TrafficGenerator::move(Station &station) {
+    //a random walk, with a tendency to keep going the same way:
+    if(random(50) == 0) station.rssiDrift = random(-1, 2);
+    station.rssi = constrain(station.rssi + station.rssiDrift + (int) random(-2, 3), -95, -20);
+}
+
+void TrafficGenerator::getBssid(int index, eth_addr &bssid) {
+    if(index >= 0 && index < bssidCount) memcpy(bssid.addr, bssids[index], 6);
+}
+
+int TrafficGenerator::getStationCount() {
+    return(stationCount);
+}
+
+int TrafficGenerator::getPresentStationCount(uint64_t nowMs) {
+    int count = 0;
+
+    for(int n = 0; n < stationCount; ++n) {
+        updatePresence(stations[n], nowMs);
+        if(stations[n].present) count++;
+    }
+
+    return(count);
+}
+
+void TrafficGenerator::randomMacAddress(uint8_t *macAddress, bool randomised) {
+    for(int n = 0; n < 6; ++n) macAddress[n] = random(256);
+
+    //individual, and locally administered if randomised:
+    macAddress[0] &= 0xFC;
+    if(randomised) macAddress[0] |= 0x02;
+}
+
+#endif
\ No newline at end of file
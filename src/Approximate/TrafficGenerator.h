@@ -0,0 +1,67 @@
+/*
+    TrafficGenerator.h
+    Approximate Library
+    -
+    David Chatting - github.com/davidchatting/Approximate
+    MIT License - Copyright (c) October 2020
+*/
+
+#ifndef TrafficGenerator_h
+#define TrafficGenerator_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "eth_addr.h"
+#include "wifi_pkt.h"
+
+//Synthetic frames from simulated stations - for load and soak testing without a radio:
+class TrafficGenerator {
+    public:
+        static const int maxStations = 256;
+        static const int maxBssids = 4;
+
+        TrafficGenerator();
+        void init(int stationCount, int bssidCount = 1, int randomisedPercent = 30, int channel = 6);
+
+        //the frame is overwritten by the next call:
+        wifi_promiscuous_pkt_t *next(uint64_t nowMs, uint16_t &len, int &type);
+
+        void getBssid(int index, eth_addr &bssid);
+        int getStationCount();
+        int getPresentStationCount(uint64_t nowMs);
+
+    private:
+        TrafficGenerator(TrafficGenerator const&);
+        void operator=(TrafficGenerator const&);
+
+        typedef struct {
+            uint8_t macAddress[6];
+            uint8_t bssidIndex;
+            bool randomised;
+            bool present;
+            int8_t rssi;
+            int8_t rssiDrift;       //walking towards (+) or away (-)
+            uint16_t sequence;
+            uint64_t changesAtMs;   //next arrival or departure
+        } Station;
+
+        Station stations[maxStations];
+        int stationCount = 0;
+
+        uint8_t bssids[maxBssids][6];
+        int bssidCount = 0;
+        int channel = 6;
+
+        //present for a minute to two hours, then away for as long - randomised addresses rotate while away:
+        static const uint32_t minDwellMs = 60000;
+        static const uint32_t maxDwellMs = 7200000;
+
+        alignas(4) uint8_t frame[sizeof(wifi_promiscuous_pkt_t) + 64];
+
+        Station *nextPresentStation(uint64_t nowMs);
+        void updatePresence(Station &station, uint64_t nowMs);
+        void move(Station &station);
+        static void randomMacAddress(uint8_t *macAddress, bool randomised);
+};
+
+#endif
@@ -25,4 +25,18 @@ typedef struct {
   uint8_t mac[6];
 } __attribute__((packed)) MacAddr;
 
+//A MAC address as a 48-bit integer key, the first octet most significant:
+static inline uint64_t eth_addr_to_uint64(const struct eth_addr *in) {
+  uint64_t out = 0;
+  for(int n=0; n<ETHARP_HWADDR_LEN; ++n) out = (out << 8) | in -> addr[n];
+  return(out);
+}
+
+static inline void uint64_to_eth_addr(uint64_t in, struct eth_addr *out) {
+  for(int n=ETHARP_HWADDR_LEN-1; n>=0; --n) {
+    out -> addr[n] = in & 0xFF;
+    in >>= 8;
+  }
+}
+
 #endif
\ No newline at end of file
@@ -105,4 +105,32 @@ typedef struct {
   unsigned char payload[];
 } __attribute__((packed)) wifi_mgmt_hdr;
 
+//Frame control, as read little-endian from the first two bytes of the header:
+#define WIFI_FCTL_TYPE(fctl)      (((fctl) >> 2) & 0x3)
+#define WIFI_FCTL_SUBTYPE(fctl)   (((fctl) >> 4) & 0xF)
+#define WIFI_FCTL_TODS            0x0100
+#define WIFI_FCTL_FROMDS          0x0200
+#define WIFI_FCTL_RETRY           0x0800
+#define WIFI_FCTL_PWRMGT          0x1000
+#define WIFI_FCTL_ORDER           0x8000
+
+#define WIFI_DATA_SUBTYPE_QOS     0x8   //QoS data subtypes have this bit set
+#define WIFI_DATA_SUBTYPE_NULL    0x4   //no data - with the QoS bit set, QoS null
+
+//The meaning of addr1-addr3 depends on the ToDS/FromDS bits, addr4 is only present when both are set:
+typedef struct {
+  unsigned fctl:16;
+  unsigned duration:16;
+  MacAddr addr1;
+  MacAddr addr2;
+  MacAddr addr3;
+  int16_t seqctl;
+  MacAddr addr4;
+} __attribute__((packed)) wifi_data_hdr;
+
+#define WIFI_DATA_HDR_LEN         24
+#define WIFI_DATA_HDR_ADDR4_LEN   6
+#define WIFI_DATA_HDR_QOS_LEN     2
+#define WIFI_DATA_HDR_HT_LEN      4
+
 #endif
\ No newline at end of file